@@ -96,31 +96,18 @@ conc_right = float(0)
 equation.concs_bound_dirich = {key_dirichlet_one: conc_left,
                                key_dirichlet_two: conc_right}
 
-# equation.cfd_procedure()
+# CFD procedure: the flow rates through the boundary faces are recorded
+# inside the time loop, concs_time keeps the concentrations of every saved
+# step, without the initial ones (drive cfd_procedure_one_step from Python
+# to change Dirichlet values between steps)
+equation.monitors.add_faces('one', boundary_faces_one)
+equation.monitors.add_faces('two', boundary_faces_two)
+concs_ini = np.copy(concs_array1)
+equation.cfd_procedure()
 
-# CFD procedure
-concs = [concs_array1, concs_array2]
-equation.concs = concs
-
-local.calc_time_steps()
 time_steps = local.time_steps
-concs_time = []
-conc_curr = copy.deepcopy(equation.concs[equation.i_curr])
-concs_time.append(conc_curr)
-flow_rate_one_time = []
-flow_rate_two_time = []
-for time_step in time_steps:
-    # modifing porosity
-    equation.cfd_procedure_one_step(time_step)
-    conc_curr = copy.deepcopy(equation.concs[equation.i_curr])
-    concs_time.append(conc_curr)
-    flow_rate_boundary_one = equation.calc_faces_flow_rate(boundary_faces_one)
-    flow_rate_boundary_two = equation.calc_faces_flow_rate(boundary_faces_two)
-    flow_rate_one_time.append(flow_rate_boundary_one)
-    flow_rate_two_time.append(flow_rate_boundary_two)
-    # new Dirichlet boundaries can be input here
-    equation.concs_bound_dirich = {key_dirichlet_one: conc_left, key_dirichlet_two: conc_right}
-equation.concs_time = concs_time
+flow_rate_one_time = equation.monitors.flow_rates['one']
+flow_rate_two_time = equation.monitors.flow_rates['two']
 #
 
 # visualising 'a' and 'b' coefficients and porosity
@@ -165,8 +152,9 @@ concs_dict = dict()
 file_name = 'inOut/collection.pvd'
 files_names = list()
 files_descriptions = list()
-for i in range(len(local.time_steps)):
-    sgrid.cells_arrays = {'conc_i': equation.concs_time[i]}
+concs_time = [concs_ini] + list(equation.concs_time)
+for i in range(len(concs_time)):
+    sgrid.cells_arrays = {'conc_i': concs_time[i]}
     files_names.append(str(i) + '.vtu')
     files_descriptions.append(str(i))
     sgrid.save_cells('inOut/' + files_names[i])
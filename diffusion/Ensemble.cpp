@@ -0,0 +1,124 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Ensemble.h"
+#include "math/threads.h"
+#include <atomic>
+#include <exception>
+#include <thread>
+
+Ensemble::Ensemble(std::shared_ptr<Equation> prototype) :
+        _prototype(prototype) {}
+
+void Ensemble::run(const std::vector<std::map<std::string,
+        std::variant<double, int>>> &paramsSets,
+                   const std::vector<std::map<std::string, double>> &concsBounds,
+                   const std::map<std::string, Eigen::VectorXui64> &facesGroups,
+                   const int &threadsN) {
+
+    _paramsSets = paramsSets;
+    _concsBounds = concsBounds;
+    _facesGroups = facesGroups;
+    _fluxOperator = std::make_shared<FluxOperator>(_prototype->_sgrid,
+                                                   _facesGroups);
+
+    auto membersN = _paramsSets.size();
+    _concs.assign(membersN, Eigen::VectorXd());
+    _flowRates.assign(membersN, {});
+    _timeSteps.assign(membersN, {});
+
+    // the topology is built once here and copied by every member
+    _prototype->updateTopology();
+
+    auto workersN = threadsN > 0 ? threadsN :
+                    std::max(1, int(std::thread::hardware_concurrency()));
+    workersN = std::min<int>(workersN, std::max<uint64_t>(membersN, 1));
+
+    std::atomic<uint64_t> memberNext(0);
+    std::vector<std::exception_ptr> exceptions(membersN);
+
+    auto work = [&]() {
+        setThreadsNLocal(1);
+        for (auto member = memberNext++; member < membersN;
+             member = memberNext++) {
+            try {
+                runMember(member);
+            } catch (...) {
+                exceptions[member] = std::current_exception();
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (int i = 1; i < workersN; i++)
+        workers.emplace_back(work);
+    work();
+    for (auto &worker : workers)
+        worker.join();
+
+    setThreadsNLocal(0);
+
+    for (auto &exception : exceptions)
+        if (exception)
+            std::rethrow_exception(exception);
+}
+
+void Ensemble::runMember(const uint64_t &member) {
+
+    auto props = std::make_shared<Props>(_paramsSets[member],
+                                         _prototype->_props->getModel());
+    Equation equation(*_prototype, props);
+    if (member < _concsBounds.size())
+        equation._concsBoundDirich = _concsBounds[member];
+    // as cfdProcedure, but the results are not written back to the sgrid
+    equation.loadConcsArrays();
+
+    auto &flowRates = _flowRates[member];
+    auto &timeSteps = equation._local->_timeSteps;
+    if (equation._local->isAdaptive()) {
+        // the monitors of the member record its accepted steps, only the
+        // final snapshot is kept
+        for (auto &[group, faces] : _facesGroups)
+            equation._monitors->addFaces(group, faces);
+        equation._outputTimes = {equation._props->_timePeriod};
+        equation.cfdProcedureAdaptive();
+        for (auto &[group, faces] : _facesGroups) {
+            auto values = equation._monitors->getFlowRates(group);
+            flowRates[group].assign(values.begin(), values.end());
+        }
+    } else {
+        equation._local->calcTimeSteps();
+        for (auto &[group, faces] : _facesGroups)
+            flowRates[group].reserve(timeSteps.size());
+
+        for (auto &timeStep : timeSteps) {
+            equation.cfdProcedureOneStep(timeStep);
+            auto groupsFlowRates = equation.calcFlowRates(*_fluxOperator);
+            for (auto &[group, index] : _fluxOperator->_indices)
+                flowRates[group].push_back(groupsFlowRates[index]);
+        }
+    }
+
+    _concs[member] = equation._concs[equation.iCurr];
+    _timeSteps[member] = timeSteps;
+}
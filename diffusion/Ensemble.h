@@ -0,0 +1,79 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef ENSEMBLE_H
+#define ENSEMBLE_H
+
+#include <iostream>
+#include <map>
+#include <variant>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Equation.h"
+
+// Runs members differing in props params and Dirichlet values on the sgrid
+// of a prototype Equation. The matrix pattern and topology of the
+// prototype are copied to every member instead of being rebuilt; members
+// run concurrently with their own coefficients, solver and state, and
+// start from the sgrid concs arrays as cfdProcedure does, leaving them
+// unchanged. Members with adaptive stepping (a time_tolerance in their
+// params) take their own accepted steps, so their flow rates go with
+// their _timeSteps. Members run serially inside
+// (threads number 1 per worker); Eigen products keep the process wide
+// threads number, set_threads_n(1) avoids oversubscription on big grids.
+class Ensemble {
+
+public:
+
+    explicit Ensemble(std::shared_ptr<Equation> prototype);
+
+    virtual ~Ensemble() {}
+
+    // paramsSets per member; concsBounds per member (the prototype ones if
+    // missing); flow rates of every faces group are recorded each step
+    void run(const std::vector<std::map<std::string,
+            std::variant<double, int>>> &paramsSets,
+             const std::vector<std::map<std::string, double>> &concsBounds,
+             const std::map<std::string, Eigen::VectorXui64> &facesGroups,
+             const int &threadsN = 0);
+
+    void runMember(const uint64_t &member);
+
+    std::shared_ptr<Equation> _prototype;
+
+    std::vector<std::map<std::string, std::variant<double, int>>> _paramsSets;
+    std::vector<std::map<std::string, double>> _concsBounds;
+    std::map<std::string, Eigen::VectorXui64> _facesGroups;
+    std::shared_ptr<FluxOperator> _fluxOperator;
+
+    // per member: final concentrations, flow rates per faces group and
+    // time steps
+    std::vector<Eigen::VectorXd> _concs;
+    std::vector<std::map<std::string, std::vector<double>>> _flowRates;
+    std::vector<std::vector<double>> _timeSteps;
+
+};
+
+#endif // ENSEMBLE_H
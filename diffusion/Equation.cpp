@@ -25,24 +25,123 @@
 #include "eigenSetGet.h"
 #include <time.h>
 #include <algorithm>
+#include <cmath>
 #include <iterator>
+#include <limits>
 #include <numeric>
-#include "math/funcs.h"
+#include <stdexcept>
+#include "math/Models.h"
+#include "math/ordering.h"
+#include "math/threads.h"
 
 Equation::Equation(std::shared_ptr<Props> props,
                    std::shared_ptr<Sgrid> sgrid,
                    std::shared_ptr<Local> local,
-                   std::shared_ptr<Convective> convective) :
+                   std::shared_ptr<Convective> convective,
+                   const bool &isPatternCalculated) :
 
         _props(props),
         _sgrid(sgrid),
         _local(local),
         _convective(convective),
+        _solver(std::make_shared<Solver>()),
         dim(_sgrid->_cellsN),
         iCurr(0), iPrev(1),
-        _concsIni(new double[dim], dim),
+        _isTopologyValid(false),
+        _state(Eigen::VectorXd::Zero(4 * dim)),
+        _concsIni(_state.data() + 2 * dim, dim),
+        _outputPeriod(1),
+        _outputTimesSaved(0),
+        _monitors(std::make_shared<Monitors>(_sgrid->_facesN, dim)),
+        _stats(std::make_shared<Stats>()),
+        _matrixCoeffs0(_sgrid->_facesN, 0),
+        _matrixCoeffs1(_sgrid->_facesN, 0),
+        _freeCoeffs0(_sgrid->_facesN, 0),
+        _freeCoeffs1(_sgrid->_facesN, 0),
+        _isTimeInvariant(false),
+        _isMatrixCurrent(false),
+        _isMatrixChanged(true),
+        _isFixedCoeffsCurrent(false),
+        _matrixTimeStep(0),
+        _matrixModel(Props::Model::linear),
+        _matrixWeighing(Convective::Weighing::meanAverage),
+        _picardIterations(0),
+        _picardIterationsTotal(0),
+        _isPicardConverged(true),
+        _scheme("implicit"),
+        _stagesN(0),
+        _isMatrixFree(false),
         matrix(dim, dim),
-        freeVector(new double[dim], dim) {
+        freeVector(_state.data() + 3 * dim, dim),
+        _isCompact(true),
+        _ordering("natural") {
+
+    _concs.emplace_back(_state.data(), dim);
+    _concs.emplace_back(_state.data() + dim, dim);
+    if (isPatternCalculated)
+        calcMatrixPattern();
+}
+
+Equation::Equation(const Equation &prototype, std::shared_ptr<Props> props) :
+        Equation(props, prototype._sgrid,
+                 std::make_shared<Local>(props, prototype._sgrid),
+                 std::make_shared<Convective>(props, prototype._sgrid),
+                 false) {
+
+    _convective->_weighing = prototype._convective->_weighing;
+
+    auto &solver = *prototype._solver;
+    _solver = std::make_shared<Solver>(solver._method, solver._preconditioner);
+    _solver->_tolerance = solver._tolerance;
+    _solver->_iterationsMax = solver._iterationsMax;
+    _solver->_refreshPeriod = solver._refreshPeriod;
+    _solver->_refreshGrowth = solver._refreshGrowth;
+
+    iCurr = prototype.iCurr;
+    iPrev = prototype.iPrev;
+    _state = prototype._state;
+    _boundGroupsDirich = prototype._boundGroupsDirich;
+    _boundGroupsNewman = prototype._boundGroupsNewman;
+    _concsBoundDirich = prototype._concsBoundDirich;
+    _isTimeInvariant = prototype._isTimeInvariant;
+    _scheme = prototype._scheme;
+
+    _nonDirichCells = prototype._nonDirichCells;
+    _isNonDirichCells = prototype._isNonDirichCells;
+    _dirichCellsActive = prototype._dirichCellsActive;
+    _fixedCouplings = prototype._fixedCouplings;
+    _fixedCoeffs.resize(_fixedCouplings.size());
+    _topologyGroups = prototype._topologyGroups;
+    _topologyTypes = prototype._topologyTypes;
+    _isTopologyValid = prototype._isTopologyValid;
+
+    _matrixCoeffs0 = prototype._matrixCoeffs0;
+    _matrixCoeffs1 = prototype._matrixCoeffs1;
+    _freeCoeffs0 = prototype._freeCoeffs0;
+    _freeCoeffs1 = prototype._freeCoeffs1;
+
+    _isMatrixFree = prototype._isMatrixFree;
+    if (_isMatrixFree)
+        _stencil = std::make_shared<Stencil>(_sgrid);
+    else {
+        matrix = prototype.matrix;
+        _slotsDiag = prototype._slotsDiag;
+        _slotsOffsets = prototype._slotsOffsets;
+        _slots = prototype._slots;
+    }
+
+    _isCompact = prototype._isCompact;
+    _ordering = prototype._ordering;
+    _matrixCompact = prototype._matrixCompact;
+    _compactCells = prototype._compactCells;
+    _compactSlots = prototype._compactSlots;
+    _inactiveCells = prototype._inactiveCells;
+    _compactFree.resize(_compactCells.size());
+    _compactGuess.resize(_compactCells.size());
+    _compactConcs.resize(_compactCells.size());
+}
+
+void Equation::calcMatrixPattern() {
 
     std::vector<Triplet> triplets;
     triplets.reserve(3 * dim - 4);
@@ -51,38 +150,230 @@ Equation::Equation(std::shared_ptr<Props> props,
         triplets.emplace_back(i, i);
 
     for (auto &nonDirichCell: findNonDirichCells(_boundGroupsDirich))
-        for (auto &face: _sgrid->_neighborsFaces[nonDirichCell])
-            for (auto &cell: _sgrid->_neighborsCells[face])
+        for (auto &face: _sgrid->_neighborsFaces.at(nonDirichCell))
+            for (auto &cell: _sgrid->_neighborsCells.at(face))
                 triplets.emplace_back(nonDirichCell, cell);
 
+    matrix.resize(dim, dim);
     matrix.setFromTriplets(triplets.begin(), triplets.end());
+    matrix.makeCompressed();
+
+    calcMatrixSlots();
+    calcCompactMatrix();
+}
+
+// Inactive cells are diagonal only rows of matrix, so they are dropped
+// from the solved system. Couplings of active to inactive cells are moved
+// to the free vector by eliminateDirichCells and hold zeros when matrix is
+// gathered, so the compact system is exact. A non-natural _ordering
+// renumbers the compact system, inactive cells or not.
+void Equation::calcCompactMatrix() {
+
+    auto activeCells = groupCellsByTypes({"active"});
+
+    _matrixCompact = Matrix();
+    _compactCells.clear();
+    _compactSlots.clear();
+    _inactiveCells.clear();
+
+    if (_isCompact and (activeCells.size() < uint64_t(dim) or
+                        _ordering != "natural")) {
+        // rcm orders the graph of the natural compact system, so only it
+        // builds the system twice
+        std::vector<uint64_t> order;
+        if (_ordering == "rcm") {
+            buildCompactMatrix(activeCells);
+            order = calcOrderingRCM(_matrixCompact);
+        } else if (_ordering == "morton") {
+            Stencil stencil(_sgrid);
+            order = calcOrderingMorton(activeCells, stencil._cellsDims,
+                                       stencil._strides);
+        }
+
+        if (order.empty())
+            buildCompactMatrix(activeCells);
+        else {
+            std::vector<uint64_t> cells(order.size());
+            for (uint64_t i = 0; i < order.size(); i++)
+                cells[i] = activeCells[order[i]];
+            buildCompactMatrix(cells);
+        }
+
+        std::vector<bool> isActiveCells(dim, false);
+        for (auto &cell : activeCells)
+            isActiveCells[cell] = true;
+        for (int i = 0; i < dim; i++)
+            if (!isActiveCells[i])
+                _inactiveCells.push_back(i);
+    }
+
+    _compactFree.resize(_compactCells.size());
+    _compactGuess.resize(_compactCells.size());
+    _compactConcs.resize(_compactCells.size());
+    _isMatrixChanged = true;
+    _solver->invalidate();
+}
+
+void Equation::buildCompactMatrix(const std::vector<uint64_t> &cells) {
+
+    std::vector<int64_t> compactIndices(dim, -1);
+    for (uint64_t i = 0; i < cells.size(); i++)
+        compactIndices[cells[i]] = i;
+
+    // entries of a row in the compact columns order, as stored
+    std::vector<Triplet> triplets;
+    std::vector<std::pair<int64_t, uint64_t>> entries;
+    _compactSlots.clear();
+    for (uint64_t i = 0; i < cells.size(); i++) {
+        entries.clear();
+        for (MatrixIterator it(matrix, cells[i]); it; ++it)
+            if (compactIndices[it.col()] >= 0)
+                entries.emplace_back(compactIndices[it.col()],
+                                     &it.valueRef() - matrix.valuePtr());
+        std::sort(entries.begin(), entries.end());
+        for (auto &[col, slot] : entries) {
+            triplets.emplace_back(i, col);
+            _compactSlots.push_back(slot);
+        }
+    }
+
+    _matrixCompact.resize(cells.size(), cells.size());
+    _matrixCompact.setFromTriplets(triplets.begin(), triplets.end());
+    _matrixCompact.makeCompressed();
+    _compactCells = cells;
+}
+
+void Equation::setOrdering(const std::string &ordering) {
+
+    if (ordering != "natural" and ordering != "rcm" and ordering != "morton")
+        throw std::invalid_argument("Equation: unknown ordering " + ordering);
+
+    _ordering = ordering;
+    if (!_isMatrixFree)
+        calcCompactMatrix();
+}
+
+void Equation::setCompact(const bool &isCompact) {
+
+    _isCompact = isCompact;
+    if (!_isMatrixFree)
+        calcCompactMatrix();
+}
+
+Matrix &Equation::getSystemMatrix() {
+    return _compactCells.empty() ? matrix : _matrixCompact;
+}
+
+void Equation::gatherCompactMatrix() {
+
+    auto values = matrix.valuePtr();
+    auto valuesCompact = _matrixCompact.valuePtr();
+    int64_t slotsN = _compactSlots.size();
+
+#pragma omp parallel for num_threads(getThreadsN(slotsN))
+    for (int64_t i = 0; i < slotsN; i++)
+        valuesCompact[i] = values[_compactSlots[i]];
+}
+
+void Equation::solveSystem(const Eigen::Ref<const Eigen::VectorXd> &guess) {
+
+    if (_isMatrixFree or _compactCells.empty()) {
+        _solver->solve(freeVector, guess, _concs[iCurr]);
+        return;
+    }
+
+    auto &concs = _concs[iCurr];
+    int64_t compactCellsN = _compactCells.size();
+    int64_t inactiveCellsN = _inactiveCells.size();
+
+#pragma omp parallel for num_threads(getThreadsN(compactCellsN))
+    for (int64_t i = 0; i < compactCellsN; i++) {
+        _compactFree[i] = freeVector[_compactCells[i]];
+        _compactGuess[i] = guess[_compactCells[i]];
+    }
+
+    _solver->solve(_compactFree, _compactGuess, _compactConcs);
+
+#pragma omp parallel for num_threads(getThreadsN(compactCellsN))
+    for (int64_t i = 0; i < compactCellsN; i++)
+        concs[_compactCells[i]] = _compactConcs[i];
+
+    auto values = matrix.valuePtr();
+    for (int64_t i = 0; i < inactiveCellsN; i++) {
+        auto &cell = _inactiveCells[i];
+        auto &diag = values[_slotsDiag[cell]];
+        concs[cell] = diag != 0 ? freeVector[cell] / diag : guess[cell];
+    }
+}
+
+void Equation::calcMatrixSlots() {
+
+    auto outerIndices = matrix.outerIndexPtr();
+    auto innerIndices = matrix.innerIndexPtr();
+
+    auto findSlot = [&](const uint64_t &row, const uint64_t &col) {
+        auto rowBegin = innerIndices + outerIndices[row];
+        auto rowEnd = innerIndices + outerIndices[row + 1];
+        auto position = std::lower_bound(rowBegin, rowEnd, col);
+        return uint64_t(position - innerIndices);
+    };
+
+    _slotsDiag.resize(dim);
+    for (int i = 0; i < dim; i++)
+        _slotsDiag[i] = findSlot(i, i);
+
+    _slots.clear();
+    _slotsOffsets.assign(dim + 1, 0);
+    auto nonDirichCells = findNonDirichCells(_boundGroupsDirich);
+    auto nonDirichCell = nonDirichCells.begin();
+    for (int i = 0; i < dim; i++) {
+        if (nonDirichCell != nonDirichCells.end() and
+            *nonDirichCell == uint64_t(i)) {
+            for (auto &face: _sgrid->_neighborsFaces.at(i))
+                for (auto &cell: _sgrid->_neighborsCells.at(face))
+                    _slots.push_back(findSlot(i, cell));
+            nonDirichCell++;
+        }
+        _slotsOffsets[i + 1] = _slots.size();
+    }
 }
 
 
 void Equation::processNewmanFaces(const double &flowNewman,
                                   Eigen::Map<Eigen::VectorXui64> faces) {
 
+    _isMatrixCurrent = false;
+
+    // the stencil is assembled from non-boundary faces only, so zeroed
+    // Newman faces coefficients do not change it
+    if (_isMatrixFree)
+        return;
+
     for (int i = 0; i < faces.size(); i++) {
         auto &face = faces[i];
-        for (auto &cell : _sgrid->_neighborsCells[face]) {
-            _matrixFacesCells[face][cell] = 0;
-            _freeFacesCells[face][cell] = flowNewman;
-        }
+        _matrixCoeffs0[face] = 0;
+        _matrixCoeffs1[face] = 0;
+        _freeCoeffs0[face] = flowNewman;
+        if (_sgrid->_neighborsCells.at(face).size() > 1)
+            _freeCoeffs1[face] = flowNewman;
     }
 
 }
 
 void Equation::processNonBoundFaces(Eigen::Ref<Eigen::VectorXui64> faces) {
 
-    for (int i = 0; i < faces.size(); i++) {
+    PhaseTimer timer(*_stats, Stats::processNonBoundFaces);
+    auto &betas = _convective->_betas;
+    int64_t facesN = faces.size();
+
+#pragma omp parallel for num_threads(getThreadsN(facesN))
+    for (int64_t i = 0; i < facesN; i++) {
         auto &face = faces[i];
-        auto &cells = _sgrid->_neighborsCells[face];
-        for (int j = 0; j < cells.size(); j++) {
-            auto &cell = cells[j];
-            auto &normal = _sgrid->_normalsNeighborsCells[face][j];
-            _matrixFacesCells[face][cell] = normal * _convective->_betas[face];
-            _freeFacesCells[face][cell] = 0;
-        }
+        auto &normals = _sgrid->_normalsNeighborsCells.at(face);
+        _matrixCoeffs0[face] = normals[0] * betas[face];
+        _matrixCoeffs1[face] = normals[1] * betas[face];
+        _freeCoeffs0[face] = 0;
+        _freeCoeffs1[face] = 0;
     }
 
 }
@@ -92,7 +383,7 @@ std::vector<uint64_t> Equation::groupCellsByTypes
 
     std::vector<uint64_t> groupedCells;
     for (auto &bound : groups) {
-        auto cells = _sgrid->_typesCells.at(bound);
+        auto &cells = _sgrid->_typesCells.at(bound);
         auto position = groupedCells.end();
         groupedCells.insert(position, cells.data(),
                             cells.data() + cells.size());
@@ -120,110 +411,653 @@ std::vector<uint64_t> Equation::findNonDirichCells(
     return nonDirichCells;
 }
 
-void Equation::fillMatrix() {
+void Equation::calcTopology() {
 
-    for (int i = 0; i < dim; ++i)
-        for (MatrixIterator it(matrix, i); it; ++it)
-            it.valueRef() = 0;
+    _nonDirichCells = findNonDirichCells(_boundGroupsDirich);
 
-    for (uint64_t i = 0; i < _sgrid->_cellsN; i++) {
-        matrix.coeffRef(i, i) = _local->_alphas[i];
-        freeVector[i] = _local->_alphas[i] * _concs[iPrev][i];
+    auto activeBoundCells = groupCellsByTypes({"active_bound"});
+
+    _dirichCellsActive.clear();
+    for (auto &bound : _boundGroupsDirich) {
+        auto dirichCells = groupCellsByTypes({bound});
+        auto &dirichCellsActive = _dirichCellsActive[bound];
+        set_intersection(activeBoundCells.begin(),
+                         activeBoundCells.end(),
+                         dirichCells.begin(),
+                         dirichCells.end(),
+                         std::back_inserter(dirichCellsActive));
+    }
+
+    _isNonDirichCells.assign(dim, false);
+    for (auto &cell : _nonDirichCells)
+        _isNonDirichCells[cell] = true;
+
+    if (!_isMatrixFree)
+        for (auto &cell : _nonDirichCells)
+            if (_slotsOffsets[cell] == _slotsOffsets[cell + 1])
+                throw std::runtime_error(
+                        "Equation: cell " + std::to_string(cell) +
+                        " is not in the matrix pattern built on construction");
+
+    auto innerIndices = matrix.innerIndexPtr();
+    _fixedCouplings.clear();
+    if (!_isMatrixFree)
+        for (auto &cell : _nonDirichCells)
+            for (auto slot = _slotsOffsets[cell];
+                 slot < _slotsOffsets[cell + 1]; slot++) {
+                uint64_t col = innerIndices[_slots[slot]];
+                if (col != cell and !_isNonDirichCells[col])
+                    _fixedCouplings.emplace_back(cell, col, _slots[slot]);
+            }
+    _fixedCoeffs.assign(_fixedCouplings.size(), 0);
+    _isMatrixCurrent = false;
+    _isFixedCoeffsCurrent = false;
+
+    _topologyGroups = _boundGroupsDirich;
+    _topologyTypes.clear();
+    auto types = _topologyGroups;
+    types.insert(types.end(), {"active", "active_bound"});
+    for (auto &type : types)
+        _topologyTypes[type] = _sgrid->_typesCells.at(type);
+
+    _isTopologyValid = true;
+}
+
+void Equation::updateTopology() {
+
+    if (_topologyGroups != _boundGroupsDirich)
+        _isTopologyValid = false;
+
+    // contents, as a reassigned type may reuse its buffer
+    for (auto &[type, cellsCopy] : _topologyTypes) {
+        if (!_isTopologyValid)
+            break;
+        auto &cells = _sgrid->_typesCells.at(type);
+        if (cellsCopy.size() != cells.size() or cellsCopy != cells)
+            _isTopologyValid = false;
     }
 
-    for (auto &nonDirichCell: findNonDirichCells(_boundGroupsDirich)) {
+    if (!_isTopologyValid)
+        calcTopology();
+}
 
-        auto faces = _sgrid->_neighborsFaces[nonDirichCell];
-        auto normalsFaces = _sgrid->_normalsNeighborsFaces[nonDirichCell];
-        for (int j = 0; j < faces.size(); j++) {
-            auto face = faces[j];
-            auto normalFace = normalsFaces[j];
-            for (const auto&[cell, cellCoeff] : _matrixFacesCells[face])
-                matrix.coeffRef(nonDirichCell, cell) += normalFace * cellCoeff;
+void Equation::invalidateTopology() {
+    _isTopologyValid = false;
+}
+
+void Equation::fillMatrix() {
+
+    PhaseTimer timer(*_stats, Stats::fillMatrix);
+    if (_isMatrixFree) {
+        fillStencil();
+        return;
+    }
+
+    updateTopology();
+
+    auto values = matrix.valuePtr();
+    int64_t valuesN = matrix.nonZeros();
+    int64_t nonDirichCellsN = _nonDirichCells.size();
+
+#pragma omp parallel for num_threads(getThreadsN(valuesN))
+    for (int64_t i = 0; i < valuesN; i++)
+        values[i] = 0;
+
+#pragma omp parallel for num_threads(getThreadsN(dim))
+    for (int64_t i = 0; i < dim; i++)
+        values[_slotsDiag[i]] = _local->_alphas[i];
+
+    fillFreeVector();
+
+    // every row is owned by one iteration
+#pragma omp parallel for num_threads(getThreadsN(nonDirichCellsN))
+    for (int64_t i = 0; i < nonDirichCellsN; i++) {
+        auto &nonDirichCell = _nonDirichCells[i];
+        auto slot = _slotsOffsets[nonDirichCell];
+
+        auto &faces = _sgrid->_neighborsFaces.at(nonDirichCell);
+        auto &normalsFaces = _sgrid->_normalsNeighborsFaces.at(nonDirichCell);
+        for (uint64_t j = 0; j < faces.size(); j++) {
+            auto &face = faces[j];
+            auto &normalFace = normalsFaces[j];
+            values[_slots[slot++]] += normalFace * _matrixCoeffs0[face];
+            if (_sgrid->_neighborsCells.at(face).size() > 1)
+                values[_slots[slot++]] += normalFace * _matrixCoeffs1[face];
         }
     }
 
+    _isMatrixCurrent = false;
+    _isMatrixChanged = true;
+    _isFixedCoeffsCurrent = false;
+}
+
+// Matrix-free counterpart of fillMatrix: the diagonal and the couplings
+// of the non-Dirichlet cells are taken straight from alphas and betas.
+void Equation::fillStencil() {
+
+    updateTopology();
+
+    auto &betas = _convective->_betas;
+    auto &faces = _sgrid->_typesFaces.at("active_nonbound");
+
+    _stencil->setZero();
+#pragma omp parallel for num_threads(getThreadsN(dim))
+    for (int64_t i = 0; i < dim; i++)
+        _stencil->_diag[i] = _local->_alphas[i];
+
+    _stencilFixed.clear();
+    for (Eigen::Index i = 0; i < faces.size(); i++) {
+        auto &face = faces[i];
+        auto &cells = _sgrid->_neighborsCells.at(face);
+        auto &normals = _sgrid->_normalsNeighborsCells.at(face);
+        auto &axis = _sgrid->_facesAxes[face];
+        auto coupling = normals[0] * normals[1] * betas[face];
+        bool isNonDirich0 = _isNonDirichCells[cells[0]];
+        bool isNonDirich1 = _isNonDirichCells[cells[1]];
+
+        if (isNonDirich0)
+            _stencil->_diag[cells[0]] += normals[0] * normals[0] * betas[face];
+        if (isNonDirich1)
+            _stencil->_diag[cells[1]] += normals[1] * normals[1] * betas[face];
+
+        if (isNonDirich0 and isNonDirich1)
+            _stencil->addCoupling(cells[0], cells[1], axis, -coupling);
+        else if (isNonDirich0)
+            _stencilFixed.emplace_back(cells[0], cells[1], coupling);
+        else if (isNonDirich1)
+            _stencilFixed.emplace_back(cells[1], cells[0], coupling);
+    }
+
+    fillFreeVector();
+
+    _isMatrixCurrent = false;
+    _isMatrixChanged = true;
+}
+
+void Equation::fillFreeVector() {
+
+#pragma omp parallel for num_threads(getThreadsN(dim))
+    for (int64_t i = 0; i < dim; i++)
+        freeVector[i] = _local->_alphas[i] * _concs[iPrev][i];
+}
+
+bool Equation::isTimeInvariant() {
+
+    return _isTimeInvariant or visitModel(*_props, [](const auto &model) {
+        return model._isConstant;
+    });
+}
+
+bool Equation::isMatrixReusable(const double &timeStep) {
+
+    return isTimeInvariant() and _isMatrixCurrent and
+           _matrixTimeStep == timeStep and _matrixParams == _props->_params and
+           _matrixModel == _props->_model and
+           _matrixWeighing == _convective->_weighing;
 }
 
 void Equation::processDirichCells(std::vector<std::string> &boundGroups,
                                   std::map<std::string, double> &concsBound) {
 
-    auto activeBoundCells = groupCellsByTypes({"active_bound"});
+    PhaseTimer timer(*_stats, Stats::processDirichCells);
+    updateTopology();
 
     for (auto &bound : boundGroups) {
         auto &conc = concsBound[bound];
-        auto dirichCells = groupCellsByTypes({bound});
+        auto &dirichCellsActive = _dirichCellsActive.at(bound);
 
-        std::vector<int> dirichCellsActive;
+        for (auto &cell : dirichCellsActive)
+            freeVector[cell] = conc * _local->_alphas[cell];
+    }
 
-        set_intersection(activeBoundCells.begin(),
-                         activeBoundCells.end(),
-                         dirichCells.begin(),
-                         dirichCells.end(),
-                         std::back_inserter(dirichCellsActive));
+    eliminateDirichCells();
+}
 
-        for (int j = 0; j < dirichCellsActive.size(); j++) {
-            auto cell = dirichCellsActive[j];
-            freeVector[cell] = conc * _local->_alphas[cell];
+// Moves couplings to cells with a diagonal only row (Dirichlet and
+// inactive cells) to the free vector, so the system stays symmetric.
+// The couplings of a freshly filled matrix are kept in _fixedCoeffs, so
+// a reused matrix only needs the free vector part. They are taken once
+// per fill, as a later call (after processNewmanFaces, say) finds them
+// zeroed in matrix.
+void Equation::eliminateDirichCells() {
+
+    if (_isMatrixFree) {
+        for (auto &[row, col, coupling] : _stencilFixed) {
+            auto &diag = _stencil->_diag[col];
+            if (diag != 0)
+                freeVector[row] -= coupling * freeVector[col] / diag;
         }
+        _isMatrixCurrent = true;
+        return;
     }
 
+    auto values = matrix.valuePtr();
+
+    if (!_isFixedCoeffsCurrent) {
+        for (uint64_t i = 0; i < _fixedCouplings.size(); i++) {
+            auto &slot = std::get<2>(_fixedCouplings[i]);
+            _fixedCoeffs[i] = values[slot];
+            values[slot] = 0;
+        }
+        _isFixedCoeffsCurrent = true;
+        _isMatrixCurrent = true;
+    }
+
+    for (uint64_t i = 0; i < _fixedCouplings.size(); i++) {
+        auto &[row, col, slot] = _fixedCouplings[i];
+        auto &diag = values[_slotsDiag[col]];
+        if (diag != 0)
+            freeVector[row] -= _fixedCoeffs[i] * freeVector[col] / diag;
+    }
 }
 
 void Equation::calcConcsImplicit() {
 
-    BiCGSTAB biCGSTAB;
+    {
+        PhaseTimer timer(*_stats, Stats::solve);
+        if (_isMatrixFree) {
+            if (_isMatrixChanged or !_solver->isComputed(*_stencil))
+                _solver->update(*_stencil);
+        } else {
+            if (_isMatrixChanged and !_compactCells.empty())
+                gatherCompactMatrix();
+            auto &systemMatrix = getSystemMatrix();
+            if (_isMatrixChanged or !_solver->isComputed(systemMatrix))
+                _solver->update(systemMatrix);
+        }
+        _isMatrixChanged = false;
+
+        solveSystem(_concs[iPrev]);
+    }
+    _stats->addSolve(_solver->_iterations, _solver->_error,
+                     _solver->_isConverged);
+}
+
+void Equation::calcConcsPicard(const double &timeStep) {
+
+    Eigen::VectorXd concsIter(dim);
+    _isPicardConverged = false;
 
-    biCGSTAB.compute(matrix);
+    while (_picardIterations < _props->_picardIterationsMax) {
 
-    _concs[iCurr] = biCGSTAB.solveWithGuess(freeVector, _concs[iPrev]);
+        concsIter = _concs[iCurr];
+        calcMatrix(_concs[iCurr], timeStep);
+        processDirichCells(_boundGroupsDirich, _concsBoundDirich);
 
+        {
+            PhaseTimer timer(*_stats, Stats::solve);
+            if (_isMatrixFree)
+                _solver->updateValues(*_stencil);
+            else {
+                if (!_compactCells.empty())
+                    gatherCompactMatrix();
+                _solver->updateValues(getSystemMatrix());
+            }
+            _isMatrixChanged = false;
+
+            solveSystem(concsIter);
+        }
+        _stats->addSolve(_solver->_iterations, _solver->_error,
+                         _solver->_isConverged);
+        _picardIterations++;
+        _picardIterationsTotal++;
+
+        auto change = (_concs[iCurr] - concsIter).lpNorm<Eigen::Infinity>();
+        auto concsMax = _concs[iCurr].lpNorm<Eigen::Infinity>();
+        if (change <= _props->_picardTolerance * concsMax) {
+            _isPicardConverged = true;
+            break;
+        }
+    }
+}
+
+void Equation::setScheme(const std::string &scheme) {
+
+    if (scheme != "implicit" and scheme != "explicit" and scheme != "rkc")
+        throw std::invalid_argument("Equation: unknown scheme " + scheme);
+    _scheme = scheme;
 }
 
-void Equation::calcConcsExplicit() {}
+// Rates of the concentrations over the whole step, from the assembled
+// (and Dirichlet eliminated) system: alpha dC = b - A C + alpha (C - C_prev)
+// for non-Dirichlet rows, zero for the fixed ones.
+void Equation::calcExplicitRates(const Eigen::Ref<const Eigen::VectorXd> &concs,
+                                 Eigen::Ref<Eigen::VectorXd> rates) {
+
+    if (_isMatrixFree) {
+        rates.setZero();
+        _stencil->applyAdd(concs, rates, 1);
+    } else
+        rates.noalias() = matrix * concs;
+
+    auto &alphas = _local->_alphas;
+    auto &concsPrev = _concs[iPrev];
+
+#pragma omp parallel for num_threads(getThreadsN(dim))
+    for (int64_t i = 0; i < dim; i++)
+        if (_isNonDirichCells[i])
+            rates[i] = (freeVector[i] - rates[i]) / alphas[i] +
+                       concs[i] - concsPrev[i];
+        else
+            rates[i] = 0;
+}
+
+// Forward Euler substeps within the CFL bound max(sum beta / alpha) or a
+// single first order Runge-Kutta-Chebyshev step with as many stages as its
+// stability interval needs. Fixed cells take their free vector values.
+void Equation::calcConcsExplicit() {
+
+    PhaseTimer timer(*_stats, Stats::solve);
+    auto &concs = _concs[iCurr];
+    auto &alphas = _local->_alphas;
+    auto diag = _isMatrixFree ? _stencil->_diag.data() : nullptr;
+    auto values = matrix.valuePtr();
+
+    double ratioMax = 0;
+    int64_t zeroAlphasN = 0;
+
+#pragma omp parallel for num_threads(getThreadsN(dim)) \
+        reduction(max:ratioMax) reduction(+:zeroAlphasN)
+    for (int64_t i = 0; i < dim; i++) {
+        auto &diagI = diag ? diag[i] : values[_slotsDiag[i]];
+        if (_isNonDirichCells[i]) {
+            if (alphas[i] > 0)
+                ratioMax = std::max(ratioMax, (diagI - alphas[i]) / alphas[i]);
+            else
+                zeroAlphasN++;
+            concs[i] = _concs[iPrev][i];
+        } else
+            concs[i] = diagI != 0 ? freeVector[i] / diagI : _concs[iPrev][i];
+    }
+
+    // no stable explicit step exists for a cell without capacity
+    if (zeroAlphasN > 0)
+        throw std::runtime_error(
+                "Equation: " + _scheme + " scheme needs positive alphas, " +
+                std::to_string(zeroAlphasN) + " cells have poro or volume 0");
+    if (!std::isfinite(ratioMax))
+        throw std::runtime_error("Equation: " + _scheme +
+                                 " scheme got non-finite coefficients");
+
+    Eigen::VectorXd rates(dim);
+
+    if (_scheme == "explicit") {
+        _stagesN = std::max(1, int(std::ceil(ratioMax)));
+        for (int k = 0; k < _stagesN; k++) {
+            calcExplicitRates(concs, rates);
+            concs += rates / _stagesN;
+        }
+        return;
+    }
+
+    // the rates operator has its eigenvalues within [-2 ratioMax, 0],
+    // stages are added until the stability interval (1 + w0) T's / Ts
+    // of the damped Chebyshev polynomial covers them
+    double damping = 0.05;
+    std::vector<double> chebyshevs{1};
+    double w0, chebyshevDeriv;
+    for (_stagesN = 1;; _stagesN++) {
+        w0 = 1 + damping / (_stagesN * _stagesN);
+        chebyshevs.assign({1, w0});
+        std::vector<double> chebyshevsDeriv{0, 1};
+        for (int j = 2; j <= _stagesN; j++) {
+            chebyshevs.push_back(2 * w0 * chebyshevs[j - 1] - chebyshevs[j - 2]);
+            chebyshevsDeriv.push_back(2 * chebyshevs[j - 1] +
+                                      2 * w0 * chebyshevsDeriv[j - 1] -
+                                      chebyshevsDeriv[j - 2]);
+        }
+        chebyshevDeriv = chebyshevsDeriv[_stagesN];
+        if ((1 + w0) * chebyshevDeriv / chebyshevs[_stagesN] >= 2 * ratioMax)
+            break;
+    }
+    auto w1 = chebyshevs[_stagesN] / chebyshevDeriv;
+
+    Eigen::VectorXd concsStage0 = concs;
+    calcExplicitRates(concsStage0, rates);
+    Eigen::VectorXd concsStage1 = concsStage0 + w1 / w0 * rates;
+
+    for (int j = 2; j <= _stagesN; j++) {
+        calcExplicitRates(concsStage1, rates);
+        auto mu = 2 * w0 * chebyshevs[j - 1] / chebyshevs[j];
+        auto nu = -chebyshevs[j - 2] / chebyshevs[j];
+        auto muRates = 2 * w1 * chebyshevs[j - 1] / chebyshevs[j];
+        concsStage0 = mu * concsStage1 + nu * concsStage0 + muRates * rates;
+        std::swap(concsStage0, concsStage1);
+    }
+    concs = concsStage1;
+}
+
+void Equation::calcMatrix(Eigen::Ref<Eigen::VectorXd> concs,
+                          const double &timeStep) {
+
+    {
+        PhaseTimer timer(*_stats, Stats::calcBetas);
+        _convective->calcBetas(concs);
+    }
+    {
+        PhaseTimer timer(*_stats, Stats::calcAlphas);
+        _local->calcAlphas(concs, timeStep);
+    }
+
+    if (!_isMatrixFree)
+        processNonBoundFaces(_sgrid->_typesFaces.at("active_nonbound"));
+    fillMatrix();
+    _matrixTimeStep = timeStep;
+    _matrixParams = _props->_params;
+    _matrixModel = _props->_model;
+    _matrixWeighing = _convective->_weighing;
+}
 
 void Equation::cfdProcedureOneStep(const double &timeStep) {
 
+    _stats->startStep();
     std::swap(iCurr, iPrev);
-    _convective->calcBetas(_concs[iPrev]);
-    _local->calcAlphas(_concs[iPrev], timeStep);
+    updateTopology();
 
-    processNonBoundFaces(_sgrid->_typesFaces.at("active_nonbound"));
-    fillMatrix();
+    auto isMatrixReused = isMatrixReusable(timeStep);
+    if (isMatrixReused)
+        fillFreeVector();
+    else
+        calcMatrix(_concs[iPrev], timeStep);
     processDirichCells(_boundGroupsDirich, _concsBoundDirich);
 
+    if (_scheme != "implicit") {
+        calcConcsExplicit();
+        _picardIterations = 0;
+        return;
+    }
+
     calcConcsImplicit();
+    _picardIterations = 1;
+    _picardIterationsTotal++;
+    _isPicardConverged = true;
+
+    if (!isMatrixReused and !isTimeInvariant() and
+        _props->_picardTolerance > 0)
+        calcConcsPicard(timeStep);
+}
 
+void Equation::cfdProcedure(const std::string &scheme) {
+
+    setScheme(scheme);
+    _stats->clear();
+
+    // the sgrid arrays are copied in and get the results back
+    loadConcsArrays();
+
+    if (_local->isAdaptive())
+        cfdProcedureAdaptive();
+    else {
+        _local->calcTimeSteps();
+        allocateSnapshots(_local->_timeSteps.size());
+        allocateMonitors(_local->_timeSteps.size());
+
+        double time = 0;
+        for (uint64_t i = 0; i < _local->_timeSteps.size(); i++) {
+            auto &timeStep = _local->_timeSteps[i];
+            cfdProcedureOneStep(timeStep);
+            time += timeStep;
+            saveSnapshot(i, time);
+            recordMonitors(time);
+        }
+    }
+
+    _sgrid->_cellsArrays.at("concs_array1") = _concs[0];
+    _sgrid->_cellsArrays.at("concs_array2") = _concs[1];
+}
+
+void Equation::loadConcsArrays() {
+
+    _concs[0] = _sgrid->_cellsArrays.at("concs_array1");
+    _concs[1] = _sgrid->_cellsArrays.at("concs_array2");
+}
+
+void Equation::allocateSnapshots(const uint64_t &stepsN) {
+
+    if (_outputPeriod < 1)
+        throw std::invalid_argument("Equation: output_period must be positive");
+
+    std::sort(_outputTimes.begin(), _outputTimes.end());
+    _outputTimesSaved = 0;
+
+    auto snapshotsN = _outputTimes.empty() ? stepsN / _outputPeriod :
+                      _outputTimes.size();
+    _snapshots = std::make_shared<Snapshots>(snapshotsN, dim, _snapshotsPath);
+}
+
+void Equation::reserveSteps(const uint64_t &stepsN) {
+
+    if (_outputTimes.empty())
+        _snapshots->reserve(stepsN / _outputPeriod);
+    _monitors->reserve(stepsN);
+}
+
+void Equation::saveSnapshot(const uint64_t &step, const double &time) {
+
+    if (_outputTimes.empty()) {
+        if ((step + 1) % _outputPeriod != 0)
+            return;
+    } else {
+        // one snapshot for all output times reached by this step
+        auto outputTimesN = _outputTimesSaved;
+        while (_outputTimesSaved < _outputTimes.size() and
+               _outputTimes[_outputTimesSaved] <= time * (1 + 1e-12))
+            _outputTimesSaved++;
+        if (outputTimesN == _outputTimesSaved)
+            return;
+    }
+
+    _snapshots->push(time, _concs[iCurr]);
+}
+
+void Equation::allocateMonitors(const uint64_t &stepsN) {
+
+    _monitors->allocate(stepsN);
+    _fluxOperator = std::make_shared<FluxOperator>(_sgrid, _monitors->_faces);
 }
 
-void Equation::cfdProcedure() {
+void Equation::recordMonitors(const double &time) {
 
-    _concs.emplace_back(_sgrid->_cellsArrays.at("concs_array1"));
-    _concs.emplace_back(_sgrid->_cellsArrays.at("concs_array2"));
+    if (_monitors->isEmpty())
+        return;
+
+    auto row = _monitors->push(time);
+    auto flowRates = calcFlowRates(*_fluxOperator);
+    for (auto &[name, index] : _fluxOperator->_indices)
+        _monitors->_flowRates[name][row] = flowRates[index];
+    for (auto &[name, cells] : _monitors->_cells) {
+        auto concs = _monitors->_concs[name].row(row);
+        for (Eigen::Index i = 0; i < cells.size(); i++)
+            concs[i] = _concs[iCurr][cells[i]];
+    }
+}
 
-    _local->calcTimeSteps();
+// Steps are accepted while the local error estimate stays within
+// time_tolerance (or the step is already time_step_min); a rejected step is
+// repeated from the same concentrations with a smaller step. The first
+// step has no history to estimate against and is always accepted.
+// _timeSteps records the accepted steps.
+void Equation::cfdProcedureAdaptive() {
+
+    auto &timePeriod = _props->_timePeriod;
+    auto timeStep = std::clamp(_props->_timeStep, _props->_timeStepMin,
+                               _props->_timeStepMax);
+    double timeStepPrev = 0;
+    double time = 0;
+    Eigen::VectorXd concsOld(dim);
+
+    // steps of the initial time step, doubled whenever they are exceeded
+    _local->_timeSteps.clear();
+    uint64_t stepsN = std::ceil(timePeriod / timeStep) + 1;
+    allocateSnapshots(stepsN);
+    allocateMonitors(stepsN);
+
+    while (timePeriod - time > timePeriod * 1e-12) {
+
+        auto isLast = timeStep >= timePeriod - time;
+        if (isLast)
+            timeStep = timePeriod - time;
 
-    for (auto &timeStep : _local->_timeSteps) {
         cfdProcedureOneStep(timeStep);
-        Eigen::Map<Eigen::VectorXd> concCurr(new double[dim], dim);
-        concCurr = _concs[iCurr];
-        _concsTime.push_back(concCurr);
+
+        double error = 0;
+        if (timeStepPrev > 0)
+            error = _local->calcTimeStepError(_concs[iCurr], _concs[iPrev],
+                                              concsOld, timeStep,
+                                              timeStepPrev);
+
+        if (error > _props->_timeTolerance and
+            timeStep > _props->_timeStepMin) {
+            // back to the concentrations before the step
+            std::swap(iCurr, iPrev);
+            timeStep = _local->calcTimeStepNext(timeStep, error);
+            continue;
+        }
+
+        concsOld = _concs[iPrev];
+        time = isLast ? timePeriod : time + timeStep;
+        timeStepPrev = timeStep;
+        _local->_timeSteps.push_back(timeStep);
+        if (_local->_timeSteps.size() > stepsN) {
+            stepsN *= 2;
+            reserveSteps(stepsN);
+        }
+        saveSnapshot(_local->_timeSteps.size() - 1, time);
+        recordMonitors(time);
+
+        timeStep = _local->calcTimeStepNext(timeStep, error);
     }
 }
 
+Eigen::VectorXd Equation::calcFlowRates(const FluxOperator &fluxOperator) {
+
+    return fluxOperator.calcFlowRates(*_props, *_convective,
+                                      _concs[iPrev], _concs[iCurr]);
+}
+
 double Equation::calcFacesFlowRate(Eigen::Ref<Eigen::VectorXui64> faces) {
 
-    auto &poroIni = std::get<double>(_props->_params["poro"]);
+    return visitModel(*_props, [&](const auto &model) {
+        return _convective->visitWeighing([&](auto weighingType) {
+            return calcFacesFlowRateByModel(model, weighingType, faces);
+        });
+    });
+}
+
+template<class Model, class WeighingType>
+double Equation::calcFacesFlowRateByModel(
+        const Model &model, WeighingType,
+        Eigen::Ref<Eigen::VectorXui64> faces) {
 
     double totalFlowRate = 0;
-    for (uint64_t i = 0; i < faces.size(); i++) {
+    for (Eigen::Index i = 0; i < faces.size(); i++) {
         auto &face = faces[i];
 
-        auto &neighborsCells = _sgrid->_neighborsCells[face];
+        auto &neighborsCells = _sgrid->_neighborsCells.at(face);
         auto &conc_prev0 = _concs[iPrev](neighborsCells[0]);
         auto &conc_prev1 = _concs[iPrev](neighborsCells[1]);
 
-        auto &normalsNeighborsCells = _sgrid->_normalsNeighborsCells[face];
+        auto &normalsNeighborsCells = _sgrid->_normalsNeighborsCells.at(face);
         auto &norm0 = normalsNeighborsCells[0];
         auto &norm1 = normalsNeighborsCells[1];
 
@@ -231,47 +1065,112 @@ double Equation::calcFacesFlowRate(Eigen::Ref<Eigen::VectorXui64> faces) {
         auto diffusivity1 = _props->calcD(conc_prev1);
 
         auto &axis = _sgrid->_facesAxes[face];
-        auto diffusivity = _convective->weighing("meanAverage",
-                                                 diffusivity0, diffusivity1);
+        auto diffusivity = Convective::weigh<WeighingType::value>(
+                diffusivity0, diffusivity1);
 
         auto &conc_curr0 = _concs[iCurr](neighborsCells[0]);
         auto &conc_curr1 = _concs[iCurr](neighborsCells[1]);
-        auto conc = _convective->weighing("meanAverage",
-                                          conc_curr0, conc_curr1);
+        auto conc = Convective::weigh<WeighingType::value>(
+                conc_curr0, conc_curr1);
         auto &dS = _sgrid->_facesSs[axis];
         auto &dL = _sgrid->_spacing[axis];
 
-        totalFlowRate -= calcPoro(conc, poroIni) * diffusivity *
+        totalFlowRate -= model.b(conc, diffusivity) *
                          (norm0 * conc_curr0 + norm1 * conc_curr1) * dS / dL;
     }
 
     return totalFlowRate;
 }
 
+bool Equation::getMatrixFree() {
+    return _isMatrixFree;
+}
+
+// Switching to the matrix-free mode releases the assembled matrix, its
+// slots and the per face coefficients; switching back rebuilds them.
+void Equation::setMatrixFree(const bool &isMatrixFree) {
+
+    if (isMatrixFree == _isMatrixFree)
+        return;
+
+    if (isMatrixFree) {
+        _stencil = std::make_shared<Stencil>(_sgrid);
+        matrix = Matrix();
+        std::vector<uint64_t>().swap(_slotsDiag);
+        std::vector<uint64_t>().swap(_slotsOffsets);
+        std::vector<uint64_t>().swap(_slots);
+        std::vector<double>().swap(_matrixCoeffs0);
+        std::vector<double>().swap(_matrixCoeffs1);
+        std::vector<double>().swap(_freeCoeffs0);
+        std::vector<double>().swap(_freeCoeffs1);
+        _matrixCompact = Matrix();
+        std::vector<uint64_t>().swap(_compactCells);
+        std::vector<uint64_t>().swap(_compactSlots);
+        std::vector<uint64_t>().swap(_inactiveCells);
+    } else {
+        _stencil.reset();
+        _matrixCoeffs0.assign(_sgrid->_facesN, 0);
+        _matrixCoeffs1.assign(_sgrid->_facesN, 0);
+        _freeCoeffs0.assign(_sgrid->_facesN, 0);
+        _freeCoeffs1.assign(_sgrid->_facesN, 0);
+        calcMatrixPattern();
+    }
+
+    _isMatrixFree = isMatrixFree;
+    _isMatrixCurrent = false;
+    _isMatrixChanged = true;
+    _isFixedCoeffsCurrent = false;
+    invalidateTopology();
+}
+
 std::vector<Eigen::Ref<Eigen::VectorXd>> Equation::getConcs() {
     return Eigen::vectorGetter<Eigen::VectorXd>(_concs);
 }
 
 void Equation::setConcs(std::vector<Eigen::Ref<Eigen::VectorXd>> &concs) {
-    Eigen::vectorSetter<Eigen::VectorXd>(concs, _concs);
+
+    if (concs.size() > _concs.size())
+        throw std::invalid_argument("Equation: concs takes two arrays");
+    for (uint64_t i = 0; i < concs.size(); i++) {
+        checkSize(concs[i]);
+        _concs[i] = concs[i];
+    }
 }
 
 std::vector<Eigen::Ref<Eigen::VectorXd>> Equation::getConcsTime() {
-    return Eigen::vectorGetter<Eigen::VectorXd>(_concsTime);
+
+    std::vector<Eigen::Ref<Eigen::VectorXd>> concsTime;
+    if (_snapshots)
+        for (uint64_t i = 0; i < _snapshots->_savedN; i++)
+            concsTime.emplace_back(_snapshots->getConcs(i));
+    return concsTime;
 }
 
+// copies concsTime to a new snapshots store with unknown times
 void Equation::setConcsTime(
         std::vector<Eigen::Ref<Eigen::VectorXd>> &concsTime) {
-    Eigen::vectorSetter<Eigen::VectorXd>(concsTime, _concsTime);
+
+    for (auto &concs : concsTime)
+        checkSize(concs);
+
+    _snapshots = std::make_shared<Snapshots>(concsTime.size(), dim);
+    for (auto &concs : concsTime)
+        _snapshots->push(std::numeric_limits<double>::quiet_NaN(), concs);
 }
 
 Eigen::Ref<Eigen::VectorXd> Equation::getConcsIni() {
     return _concsIni;
 }
 
-void Equation::setConcsIni(Eigen::Ref<Eigen::VectorXd> concsIni) {
-    if (_concsIni.data() != concsIni.data())
-        delete _concsIni.data();
-    new(&_concsIni) Eigen::Map<Eigen::VectorXd>(concsIni.data(),
-                                                concsIni.size());
+void Equation::setConcsIni(const Eigen::Ref<const Eigen::VectorXd> &concsIni) {
+    checkSize(concsIni);
+    _concsIni = concsIni;
+}
+
+void Equation::checkSize(const Eigen::Ref<const Eigen::VectorXd> &concs) {
+    if (concs.size() != dim)
+        throw std::invalid_argument(
+                "Equation: concentrations size " +
+                std::to_string(concs.size()) + " differs from cells number " +
+                std::to_string(dim));
 }
\ No newline at end of file
@@ -26,6 +26,7 @@
 
 #include <iostream>
 #include <map>
+#include <tuple>
 #include <vector>
 
 #include <Eigen/Dense>
@@ -34,13 +35,21 @@
 #include "math/Props.h"
 #include "math/Local.h"
 #include "math/Convective.h"
+#include "math/Solver.h"
+#include "math/Snapshots.h"
+#include "math/Monitors.h"
+#include "math/FluxOperator.h"
+#include "math/Stats.h"
 #include <sgrid/Sgrid.h>
 
 typedef Eigen::Triplet<double> Triplet;
-typedef Eigen::SparseMatrix<double, Eigen::RowMajor> Matrix;
 typedef Matrix::InnerIterator MatrixIterator;
-typedef Eigen::BiCGSTAB<Eigen::SparseMatrix<double>> BiCGSTAB;
 
+// Thread safety: the Python bindings of the long-running methods release
+// the GIL. Distinct Equation (with their Local, Convective and Solver)
+// instances may run concurrently; a shared Sgrid and Props are only read.
+// cfdProcedure copies the sgrid concs arrays in and writes them back, so
+// Equations sharing an Sgrid should use cfdProcedureOneStep or Ensemble.
 class Equation {
 
 public:
@@ -48,7 +57,12 @@ public:
     explicit Equation(std::shared_ptr<Props> props,
                       std::shared_ptr<Sgrid> sgrid,
                       std::shared_ptr<Local> local,
-                      std::shared_ptr<Convective> convective);
+                      std::shared_ptr<Convective> convective,
+                      const bool &isPatternCalculated = true);
+
+    // ensemble member: own props, coefficients, solver and state; the
+    // sgrid, matrix pattern, topology, boundaries and settings of prototype
+    explicit Equation(const Equation &prototype, std::shared_ptr<Props> props);
 
     virtual ~Equation() {}
 
@@ -62,7 +76,9 @@ public:
 
     Eigen::Ref<Eigen::VectorXd> getConcsIni();
 
-    void setConcsIni(Eigen::Ref<Eigen::VectorXd> concsIni);
+    void setConcsIni(const Eigen::Ref<const Eigen::VectorXd> &concsIni);
+
+    void checkSize(const Eigen::Ref<const Eigen::VectorXd> &concs);
 
     void processNewmanFaces(const double &flowNewman,
                             Eigen::Map<Eigen::VectorXui64> faces);
@@ -70,32 +86,121 @@ public:
     void processDirichCells(std::vector<std::string> &boundGroups,
                             std::map<std::string, double> &concsBound);
 
+    void eliminateDirichCells();
+
     std::vector<uint64_t> findNonDirichCells
             (std::vector<std::string> &boundGroupsDirich);
 
     std::vector<uint64_t> groupCellsByTypes
             (const std::vector<std::string> &groups);
 
+    void calcTopology();
+
+    void updateTopology();
+
+    void invalidateTopology();
+
     void processNonBoundFaces(Eigen::Ref<Eigen::VectorXui64> faces);
 
     void fillMatrix();
 
+    // coefficients at concs, the matrix (or stencil) and the free vector
+    void calcMatrix(Eigen::Ref<Eigen::VectorXd> concs, const double &timeStep);
+
+    void fillStencil();
+
+    void fillFreeVector();
+
+    bool isTimeInvariant();
+
+    bool isMatrixReusable(const double &timeStep);
+
+    void calcMatrixPattern();
+
+    void calcMatrixSlots();
+
+    // numbering of the active cells and the pattern of matrix restricted
+    // to them, used by the solver if some cells are inactive
+    void calcCompactMatrix();
+
+    // compact system rows and values for cells in this order
+    void buildCompactMatrix(const std::vector<uint64_t> &cells);
+
+    void setCompact(const bool &isCompact);
+
+    // natural, rcm (reverse Cuthill-McKee) or morton; the permuted pattern
+    // is factorized anew by the solver on the next update
+    void setOrdering(const std::string &ordering);
+
+    // the matrix the solver works on
+    Matrix &getSystemMatrix();
+
+    // copies the active rows and columns of a changed matrix
+    void gatherCompactMatrix();
+
+    // solves for _concs[iCurr] from guess, inactive cells keep their
+    // diagonal only row solution
+    void solveSystem(const Eigen::Ref<const Eigen::VectorXd> &guess);
+
+    bool getMatrixFree();
+
+    void setMatrixFree(const bool &isMatrixFree);
+
     void calcConcsIni();
 
     void calcConcsImplicit();
 
+    // repeats the step with coefficients evaluated at the last iterate
+    // until the relative change drops below picard_tolerance
+    void calcConcsPicard(const double &timeStep);
+
     void calcConcsExplicit();
 
+    void calcExplicitRates(const Eigen::Ref<const Eigen::VectorXd> &concs,
+                           Eigen::Ref<Eigen::VectorXd> rates);
+
+    void setScheme(const std::string &scheme);
+
     void cfdProcedureOneStep(const double &timeStep);
 
-    void cfdProcedure();
+    // scheme: implicit, explicit (CFL bounded substeps) or rkc
+    void cfdProcedure(const std::string &scheme = "implicit");
+
+    // _concs from the sgrid concs arrays, where cfdProcedure starts from
+    void loadConcsArrays();
+
+    void cfdProcedureAdaptive();
+
+    // snapshots store for a run of stepsN steps (an estimate of them for
+    // adaptive stepping) and the output schedule
+    void allocateSnapshots(const uint64_t &stepsN);
+
+    // grows the snapshots and monitors of the run for stepsN steps
+    void reserveSteps(const uint64_t &stepsN);
+
+    void saveSnapshot(const uint64_t &step, const double &time);
+
+    // _monitors rows for stepsN steps and the flux operator of its faces
+    void allocateMonitors(const uint64_t &stepsN);
+
+    // a row of _monitors for the step that reached time
+    void recordMonitors(const double &time);
+
+    // flow rates of all fluxOperator groups at the current concentrations
+    Eigen::VectorXd calcFlowRates(const FluxOperator &fluxOperator);
 
     double calcFacesFlowRate(Eigen::Ref<Eigen::VectorXui64> faces);
 
+    template<class Model, class WeighingType>
+    double calcFacesFlowRateByModel(const Model &model,
+                                    WeighingType weighingType,
+                                    Eigen::Ref<Eigen::VectorXui64> faces);
+
     std::shared_ptr<Props> _props;
     std::shared_ptr<Sgrid> _sgrid;
     std::shared_ptr<Local> _local;
     std::shared_ptr<Convective> _convective;
+    std::shared_ptr<Solver> _solver;
 
     int dim;
     int iCurr;
@@ -105,16 +210,102 @@ public:
     std::vector<std::string> _boundGroupsNewman;
     std::map<std::string, double> _concsBoundDirich;
 
+    // cells grouping cached by calcTopology, rebuilt by updateTopology
+    // once _boundGroupsDirich or the contents of the sgrid cells types it
+    // was built from (copied to _topologyTypes) change
+    std::vector<uint64_t> _nonDirichCells;
+    std::vector<bool> _isNonDirichCells;
+    std::map<std::string, std::vector<uint64_t>> _dirichCellsActive;
+    // non-Dirichlet rows coupled to a fixed (diagonal only) cell:
+    // row, column and slot of the coupling in matrix.valuePtr()
+    std::vector<std::tuple<uint64_t, uint64_t, uint64_t>> _fixedCouplings;
+    std::vector<double> _fixedCoeffs;
+    std::vector<std::string> _topologyGroups;
+    std::map<std::string, Eigen::VectorXui64> _topologyTypes;
+    bool _isTopologyValid;
+
+    // owned state: both concentrations buffers, the initial concentrations
+    // and the free vector, dim values each; setters copy into it
+    Eigen::VectorXd _state;
     std::vector<Eigen::Map<Eigen::VectorXd>> _concs;
-    std::vector<Eigen::Map<Eigen::VectorXd>> _concsTime;
     Eigen::Map<Eigen::VectorXd> _concsIni;
 
-    std::map<int, std::map<int, double>> _matrixFacesCells;
-    std::map<int, std::map<int, double>> _freeFacesCells;
+    // concs_time: cfdProcedure saves every _outputPeriod step or, if
+    // _outputTimes is not empty, the first step reaching each of them; a
+    // non-empty _snapshotsPath maps the store to that file
+    int _outputPeriod;
+    std::vector<double> _outputTimes;
+    std::string _snapshotsPath;
+    std::shared_ptr<Snapshots> _snapshots;
+    uint64_t _outputTimesSaved;
+
+    // faces and cells groups recorded by cfdProcedure every step
+    std::shared_ptr<Monitors> _monitors;
+    std::shared_ptr<FluxOperator> _fluxOperator;
+
+    // per step phases seconds and solves, cleared by cfdProcedure
+    std::shared_ptr<Stats> _stats;
+
+    // per face coefficients of the first and second neighbour cells
+    // in _neighborsCells order
+    std::vector<double> _matrixCoeffs0;
+    std::vector<double> _matrixCoeffs1;
+    std::vector<double> _freeCoeffs0;
+    std::vector<double> _freeCoeffs1;
+
+    // with coefficients independent of concentration (declared or
+    // constant for the model and params) the matrix assembled and
+    // factorized for a time step is reused while the time step, params,
+    // model, weighing and topology stay the same; Dirichlet values only
+    // enter the free vector, and a replaced _solver computes anew
+    bool _isTimeInvariant;
+    bool _isMatrixCurrent;
+    bool _isMatrixChanged;
+    // _fixedCoeffs were taken from the matrix filled last
+    bool _isFixedCoeffsCurrent;
+    double _matrixTimeStep;
+    std::map<std::string, std::variant<double, int>> _matrixParams;
+    Props::Model _matrixModel;
+    Convective::Weighing _matrixWeighing;
+
+    // linear solves of the last step and their total, Picard included
+    int _picardIterations;
+    int _picardIterationsTotal;
+    bool _isPicardConverged;
+
+    // time scheme of cfdProcedureOneStep and the explicit substeps or
+    // stages of its last step
+    std::string _scheme;
+    int _stagesN;
+
+    // matrix-free mode: _stencil replaces the assembled matrix, couplings
+    // to Dirichlet cells are kept as (row, column, coupling)
+    bool _isMatrixFree;
+    std::shared_ptr<Stencil> _stencil;
+    std::vector<std::tuple<uint64_t, uint64_t, double>> _stencilFixed;
 
     Matrix matrix;
     Eigen::Map<Eigen::VectorXd> freeVector;
 
+    // positions in matrix.valuePtr(): diagonal per cell and, per row,
+    // (face, neighbour cell) contributions in _neighborsFaces order
+    std::vector<uint64_t> _slotsDiag;
+    std::vector<uint64_t> _slotsOffsets;
+    std::vector<uint64_t> _slots;
+
+    // compact system on the active cells: _compactCells maps its rows to
+    // cells in _ordering, _compactSlots its values to matrix.valuePtr();
+    // empty if all cells are active in natural ordering or _isCompact is off
+    bool _isCompact;
+    std::string _ordering;
+    Matrix _matrixCompact;
+    std::vector<uint64_t> _compactCells;
+    std::vector<uint64_t> _compactSlots;
+    std::vector<uint64_t> _inactiveCells;
+    Eigen::VectorXd _compactFree;
+    Eigen::VectorXd _compactGuess;
+    Eigen::VectorXd _compactConcs;
+
 
 };
 
@@ -0,0 +1,372 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Benchmark of the assembly, solve and step pipeline on synthetic sgrids:
+// dense 2D and 3D boxes and a random porous mask. Every phase is timed
+// separately (median of the repeats) for every threads number and the
+// results are written as JSON, one record per line; with --baseline the
+// records are compared to a stored run and the exit code is 1 if any
+// phase got slower than the tolerance allows.
+//
+// diffusion_benchmark [--cases box2d,box3d,mask3d] [--cells 1e4,1e5,1e6]
+//                     [--threads 1,2,4] [--orderings natural,rcm,morton]
+//                     [--repeats 5] [--steps 10]
+//                     [--method bicgstab] [--preconditioner jacobi]
+//                     [--output results.json] [--baseline baseline.json]
+//                     [--tolerance 0.2]
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+#include "Equation.h"
+#include "math/threads.h"
+
+struct Options {
+    std::vector<std::string> cases{"box2d", "box3d", "mask3d"};
+    std::vector<uint64_t> cellsNs{10000, 100000, 1000000};
+    std::vector<int> threadsNs{1};
+    std::vector<std::string> orderings{"natural"};
+    int repeatsN = 5;
+    int stepsN = 10;
+    std::string method = "bicgstab";
+    std::string preconditioner = "jacobi";
+    std::string output;
+    std::string baseline;
+    double tolerance = 0.2;
+};
+
+struct Record {
+    std::string caseName;
+    uint64_t cellsN;
+    int threadsN;
+    std::string ordering;
+    std::string phase;
+    double seconds;
+};
+
+// a synthetic case: the sgrid and the arrays it maps
+struct Case {
+    std::shared_ptr<Sgrid> sgrid;
+    Eigen::VectorXd concsArray1;
+    Eigen::VectorXd concsArray2;
+    std::vector<std::string> boundGroups;
+    std::map<std::string, double> concsBound;
+};
+
+static std::vector<std::string> split(const std::string &values) {
+    std::vector<std::string> items;
+    std::stringstream stream(values);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+static Options parseOptions(int argc, char **argv) {
+
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        std::string option = argv[i];
+        if (i + 1 == argc)
+            throw std::invalid_argument("benchmark: " + option +
+                                        " needs a value");
+        std::string value = argv[++i];
+
+        if (option == "--cases")
+            options.cases = split(value);
+        else if (option == "--cells") {
+            options.cellsNs.clear();
+            for (auto &item : split(value))
+                options.cellsNs.push_back(std::stod(item));
+        } else if (option == "--threads") {
+            options.threadsNs.clear();
+            for (auto &item : split(value))
+                options.threadsNs.push_back(std::stoi(item));
+        } else if (option == "--orderings")
+            options.orderings = split(value);
+        else if (option == "--repeats")
+            options.repeatsN = std::stoi(value);
+        else if (option == "--steps")
+            options.stepsN = std::stoi(value);
+        else if (option == "--method")
+            options.method = value;
+        else if (option == "--preconditioner")
+            options.preconditioner = value;
+        else if (option == "--output")
+            options.output = value;
+        else if (option == "--baseline")
+            options.baseline = value;
+        else if (option == "--tolerance")
+            options.tolerance = std::stod(value);
+        else
+            throw std::invalid_argument("benchmark: unknown option " + option);
+    }
+
+    if (options.repeatsN < 1 or options.stepsN < 1)
+        throw std::invalid_argument(
+                "benchmark: repeats and steps must be positive");
+    return options;
+}
+
+static Case createCase(const std::string &caseName, const uint64_t &cellsN) {
+
+    Eigen::Vector3ui16 pointsDims;
+    if (caseName == "box2d") {
+        uint16_t cellsDim = std::round(std::sqrt(cellsN));
+        pointsDims << cellsDim + 1, cellsDim + 1, 2;
+    } else if (caseName == "box3d" or caseName == "mask3d") {
+        uint16_t cellsDim = std::round(std::cbrt(cellsN));
+        pointsDims << cellsDim + 1, cellsDim + 1, cellsDim + 1;
+    } else
+        throw std::invalid_argument("benchmark: unknown case " + caseName);
+
+    Eigen::Vector3d pointsOrigin(0, 0, 0);
+    Eigen::Vector3d spacing(1, 1, 1);
+
+    Case benchmarkCase;
+    auto &sgrid = benchmarkCase.sgrid;
+    sgrid = std::make_shared<Sgrid>(pointsDims, pointsOrigin, spacing);
+
+    // mask3d keeps 70% of cells at random, a stand-in for a porous sample image
+    std::vector<uint64_t> activeCells;
+    std::mt19937 generator(0);
+    std::uniform_real_distribution<double> distribution(0, 1);
+    for (uint64_t cell = 0; cell < sgrid->_cellsN; cell++)
+        if (caseName != "mask3d" or distribution(generator) < 0.7)
+            activeCells.push_back(cell);
+
+    Eigen::VectorXui64 cells(activeCells.size());
+    std::copy(activeCells.begin(), activeCells.end(), cells.begin());
+    sgrid->setCellsType("active", cells);
+    sgrid->processTypesByCellsType("active");
+
+    benchmarkCase.concsArray1 = Eigen::VectorXd::Zero(sgrid->_cellsN);
+    benchmarkCase.concsArray2 = Eigen::VectorXd::Zero(sgrid->_cellsN);
+    for (auto &name : {"concs_array1", "concs_array2"})
+        sgrid->_cellsArrays.erase(name);
+    sgrid->_cellsArrays.emplace("concs_array1", Eigen::Map<Eigen::VectorXd>(
+            benchmarkCase.concsArray1.data(), sgrid->_cellsN));
+    sgrid->_cellsArrays.emplace("concs_array2", Eigen::Map<Eigen::VectorXd>(
+            benchmarkCase.concsArray2.data(), sgrid->_cellsN));
+
+    // left and right for every case, active_bound of mask3d holds most cells
+    benchmarkCase.boundGroups = {"left", "right"};
+    benchmarkCase.concsBound = {{"left", 20.}, {"right", 0.}};
+
+    return benchmarkCase;
+}
+
+// median seconds of repeatsN calls
+template<class Function>
+static double measure(const int &repeatsN, Function &&function) {
+
+    std::vector<double> seconds;
+    for (int i = 0; i < repeatsN; i++) {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double> duration =
+                std::chrono::steady_clock::now() - start;
+        seconds.push_back(duration.count());
+    }
+    std::sort(seconds.begin(), seconds.end());
+    return seconds[seconds.size() / 2];
+}
+
+static void runCase(const Options &options, const std::string &caseName,
+                    const uint64_t &cellsN, const int &threadsN,
+                    const std::string &ordering,
+                    std::vector<Record> &records) {
+
+    auto benchmarkCase = createCase(caseName, cellsN);
+    auto &sgrid = benchmarkCase.sgrid;
+    setThreadsN(threadsN);
+
+    // d_coeff_a makes the coefficients depend on concentration, so every
+    // step assembles and factorizes the matrix
+    double timeStep = 1;
+    std::map<std::string, std::variant<double, int>> params{
+            {"time_period", timeStep * options.stepsN},
+            {"time_step", timeStep}, {"d_coeff_a", 0.01},
+            {"d_coeff_b", 0.15}, {"poro", 0.5}};
+    auto props = std::make_shared<Props>(params);
+    auto local = std::make_shared<Local>(props, sgrid);
+    auto convective = std::make_shared<Convective>(props, sgrid);
+    auto equation = std::make_shared<Equation>(props, sgrid, local,
+                                               convective);
+    equation->_solver = std::make_shared<Solver>(options.method,
+                                                 options.preconditioner);
+    equation->setOrdering(ordering);
+    equation->_boundGroupsDirich = benchmarkCase.boundGroups;
+    equation->_concsBoundDirich = benchmarkCase.concsBound;
+
+    auto addRecord = [&](const std::string &phase, const double &seconds) {
+        records.push_back({caseName, sgrid->_cellsN, threadsN, ordering,
+                           phase, seconds});
+        std::cerr << caseName << " " << sgrid->_cellsN << " cells "
+                  << threadsN << " threads " << ordering << " " << phase
+                  << " " << seconds << " s" << std::endl;
+    };
+
+    auto concs = equation->_concs[equation->iCurr];
+    auto &repeatsN = options.repeatsN;
+
+    addRecord("calc_betas", measure(repeatsN, [&]() {
+        convective->calcBetas(concs);
+    }));
+    addRecord("calc_alphas", measure(repeatsN, [&]() {
+        local->calcAlphas(concs, timeStep);
+    }));
+    equation->processNonBoundFaces(sgrid->_typesFaces.at("active_nonbound"));
+    addRecord("fill_matrix", measure(repeatsN, [&]() {
+        equation->fillMatrix();
+    }));
+    equation->processDirichCells(equation->_boundGroupsDirich,
+                                 equation->_concsBoundDirich);
+    addRecord("calc_concs_implicit", measure(repeatsN, [&]() {
+        equation->_isMatrixChanged = true;
+        equation->calcConcsImplicit();
+    }));
+    addRecord("one_step", measure(repeatsN, [&]() {
+        equation->cfdProcedureOneStep(timeStep);
+    }));
+    addRecord("cfd_procedure", measure(repeatsN, [&]() {
+        benchmarkCase.concsArray1.setZero();
+        benchmarkCase.concsArray2.setZero();
+        equation->cfdProcedure();
+    }));
+}
+
+static void writeRecords(const Options &options,
+                         const std::vector<Record> &records,
+                         std::ostream &stream) {
+
+    stream << "{\"repeats\": " << options.repeatsN
+           << ", \"steps\": " << options.stepsN
+           << ", \"method\": \"" << options.method
+           << "\", \"preconditioner\": \"" << options.preconditioner
+           << "\", \"records\": [" << std::endl;
+    for (uint64_t i = 0; i < records.size(); i++) {
+        auto &record = records[i];
+        stream << "{\"case\": \"" << record.caseName
+               << "\", \"cells\": " << record.cellsN
+               << ", \"threads\": " << record.threadsN
+               << ", \"ordering\": \"" << record.ordering << "\""
+               << ", \"phase\": \"" << record.phase
+               << "\", \"seconds\": " << record.seconds << "}"
+               << (i + 1 < records.size() ? "," : "") << std::endl;
+    }
+    stream << "]}" << std::endl;
+}
+
+// value of key in a record line written by writeRecords
+static std::string getField(const std::string &line, const std::string &key) {
+
+    auto start = line.find("\"" + key + "\": ");
+    if (start == std::string::npos)
+        return "";
+    start += key.size() + 4;
+    if (line[start] == '"')
+        return line.substr(start + 1, line.find('"', start + 1) - start - 1);
+    return line.substr(start, line.find_first_of(",}", start) - start);
+}
+
+// number of phases slower than the baseline by more than the tolerance
+static int compareRecords(const Options &options,
+                          const std::vector<Record> &records) {
+
+    std::ifstream file(options.baseline);
+    if (!file)
+        throw std::runtime_error("benchmark: can not open " +
+                                 options.baseline);
+
+    std::map<std::tuple<std::string, uint64_t, int, std::string,
+            std::string>, double> baseline;
+    std::string line;
+    while (std::getline(file, line)) {
+        if (getField(line, "phase").empty())
+            continue;
+        baseline[{getField(line, "case"), std::stoull(getField(line, "cells")),
+                  std::stoi(getField(line, "threads")),
+                  getField(line, "ordering"), getField(line, "phase")}] =
+                std::stod(getField(line, "seconds"));
+    }
+
+    int regressionsN = 0;
+    for (auto &record : records) {
+        auto found = baseline.find({record.caseName, record.cellsN,
+                                    record.threadsN, record.ordering,
+                                    record.phase});
+        if (found == baseline.end())
+            continue;
+        auto ratio = record.seconds / found->second;
+        auto isRegression = ratio > 1 + options.tolerance;
+        regressionsN += isRegression;
+        std::cerr << record.caseName << " " << record.cellsN << " cells "
+                  << record.threadsN << " threads " << record.ordering
+                  << " " << record.phase
+                  << " " << ratio << " of baseline"
+                  << (isRegression ? " REGRESSION" : "") << std::endl;
+    }
+    return regressionsN;
+}
+
+int main(int argc, char **argv) {
+
+    try {
+        auto options = parseOptions(argc, argv);
+
+        std::vector<Record> records;
+        for (auto &caseName : options.cases)
+            for (auto &cellsN : options.cellsNs)
+                for (auto &threadsN : options.threadsNs)
+                    for (auto &ordering : options.orderings)
+                        runCase(options, caseName, cellsN, threadsN,
+                                ordering, records);
+
+        if (options.output.empty())
+            writeRecords(options, records, std::cout);
+        else {
+            std::ofstream file(options.output);
+            writeRecords(options, records, file);
+        }
+
+        if (!options.baseline.empty() and compareRecords(options, records))
+            return 1;
+    } catch (const std::exception &exception) {
+        std::cerr << exception.what() << std::endl;
+        return 2;
+    }
+    return 0;
+}
@@ -35,8 +35,8 @@ void Boundary::shiftBoundaryFaces(Eigen::Ref<Eigen::VectorXui64> faces,
 
     for (uint64_t i = 0; i < faces.size(); i++) {
         auto &face = faces[i];
-        auto neighborCell = _sgrid->_neighborsCells[face][0];
-        for (auto &neighborFace: _sgrid->_neighborsFaces[neighborCell]) {
+        auto neighborCell = _sgrid->_neighborsCells.at(face)[0];
+        for (auto &neighborFace: _sgrid->_neighborsFaces.at(neighborCell)) {
             auto neighborFaceAxis = _sgrid->calculateAxisFace(neighborFace);
             if (neighborFace != face and neighborFaceAxis == axis) {
                 face = neighborFace;
@@ -22,43 +22,93 @@
  */
 
 #include "Convective.h"
-#include "funcs.h"
+#include "Models.h"
+#include "threads.h"
 #include <algorithm>
 #include <iterator>
+#include <stdexcept>
+
+static const std::map<std::string, Convective::Weighing> weighingsNames{
+        {"meanAverage",  Convective::Weighing::meanAverage},
+        {"meanHarmonic", Convective::Weighing::meanHarmonic},
+        {"upWind",       Convective::Weighing::upWind},
+        {"geometric",    Convective::Weighing::geometric}};
 
 Convective::Convective(std::shared_ptr<Props> props,
-                       std::shared_ptr<Sgrid> sgrid) :
+                       std::shared_ptr<Sgrid> sgrid,
+                       const std::string &weighing) :
         _props(props),
         _sgrid(sgrid),
-        _betas(_sgrid->_facesN) {}
+        _weighing(parseWeighing(weighing)),
+        _betas(_sgrid->_facesN),
+        _diffusivities(_sgrid->_cellsN) {}
+
+Convective::Weighing Convective::parseWeighing(const std::string &weighing) {
+
+    auto it = weighingsNames.find(weighing);
+    if (it == weighingsNames.end())
+        throw std::invalid_argument("Convective: unknown weighing " + weighing);
+    return it->second;
+}
+
+void Convective::setWeighing(const std::string &weighing) {
+    _weighing = parseWeighing(weighing);
+}
+
+std::string Convective::getWeighing() {
+
+    for (auto &[name, weighing] : weighingsNames)
+        if (weighing == _weighing)
+            return name;
+    return "";
+}
 
 double Convective::weighing(const std::string &method, const double &value0,
                             const double &value1) {
 
-    if (method == "meanAverage")
-        return (value0 + value1) / 2;
-    else if (method == "meanHarmonic")
-        return 2. * value0 * value1 / (value0 + value1);
-    else if (method == "upWind")
-        return std::max(value0, value1);
-    else exit(0);
+    switch (parseWeighing(method)) {
+        case Weighing::meanAverage:
+            return weigh<Weighing::meanAverage>(value0, value1);
+        case Weighing::meanHarmonic:
+            return weigh<Weighing::meanHarmonic>(value0, value1);
+        case Weighing::upWind:
+            return weigh<Weighing::upWind>(value0, value1);
+        default:
+            return weigh<Weighing::geometric>(value0, value1);
+    }
 }
 
 // ToDo: massive of diffusions which are going to be different for matrix and fractures
 void Convective::calcBetas(Eigen::Ref<Eigen::VectorXd> concs) {
 
+    _props->calcD(concs, _diffusivities);
+
+    visitModel(*_props, [&](const auto &model) {
+        visitWeighing([&](auto weighingType) {
+            calcBetasByModel(model, weighingType, concs);
+        });
+    });
+}
+
+template<class Model, class WeighingType>
+void Convective::calcBetasByModel(const Model &model, WeighingType,
+                                  Eigen::Ref<Eigen::VectorXd> concs) {
+
     auto &neighborsCells = _sgrid->_neighborsCells;
-    auto boundFaces = _sgrid->_typesFaces.at("active_bound");
-    auto nonBoundFaces = _sgrid->_typesFaces.at("active_nonbound");
-    auto poroIni = std::get<double>(_props->_params["poro"]);
+    auto &boundFaces = _sgrid->_typesFaces.at("active_bound");
+    auto &nonBoundFaces = _sgrid->_typesFaces.at("active_nonbound");
+
+    int64_t boundFacesN = boundFaces.size();
+    int64_t nonBoundFacesN = nonBoundFaces.size();
 
-    for (int i = 0; i < boundFaces.size(); i++) {
+#pragma omp parallel for num_threads(getThreadsN(boundFacesN))
+    for (int64_t i = 0; i < boundFacesN; i++) {
         auto boundFace = boundFaces[i];
         auto &faceNeighborsCell = neighborsCells[boundFace];
         auto &conc0 = concs(faceNeighborsCell[0]);
 
-        auto diffusivity0 = _props->calcD(conc0);
-        auto bCoeff = calcBFunc(conc0, diffusivity0, poroIni);
+        auto &diffusivity0 = _diffusivities[faceNeighborsCell[0]];
+        auto bCoeff = model.b(conc0, diffusivity0);
 
         auto &axis = _sgrid->_facesAxes[boundFace];
 
@@ -66,18 +116,19 @@ void Convective::calcBetas(Eigen::Ref<Eigen::VectorXd> concs) {
                 bCoeff * _sgrid->_facesSs[axis] / _sgrid->_spacing[axis];
     }
 
-    for (int i = 0; i < nonBoundFaces.size(); i++) {
+#pragma omp parallel for num_threads(getThreadsN(nonBoundFacesN))
+    for (int64_t i = 0; i < nonBoundFacesN; i++) {
         auto nonBoundFace = nonBoundFaces[i];
         auto &faceNeighborsCell = neighborsCells[nonBoundFace];
         auto &conc0 = concs(faceNeighborsCell[0]);
         auto &conc1 = concs(faceNeighborsCell[1]);
 
-        auto diffusivity0 = _props->calcD(conc0);
-        auto diffusivity1 = _props->calcD(conc1);
-        auto bCoeff0 = calcBFunc(conc0, diffusivity0, poroIni);
-        auto bCoeff1 = calcBFunc(conc1, diffusivity1, poroIni);
+        auto &diffusivity0 = _diffusivities[faceNeighborsCell[0]];
+        auto &diffusivity1 = _diffusivities[faceNeighborsCell[1]];
+        auto bCoeff0 = model.b(conc0, diffusivity0);
+        auto bCoeff1 = model.b(conc1, diffusivity1);
 
-        auto bCoeff = weighing("meanAverage", bCoeff0, bCoeff1);
+        auto bCoeff = weigh<WeighingType::value>(bCoeff0, bCoeff1);
         auto &axis = _sgrid->_facesAxes[nonBoundFace];
 
         _betas[nonBoundFace] = bCoeff * _sgrid->_facesSs[axis]
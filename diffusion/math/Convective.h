@@ -28,6 +28,9 @@
 #include <map>
 #include <vector>
 
+#include <cmath>
+#include <type_traits>
+
 #include <Eigen/Dense>
 
 #include "Props.h"
@@ -37,20 +40,74 @@ class Convective {
 
 public:
 
+    // face values from the values of the two neighbour cells
+    enum class Weighing {
+        meanAverage, meanHarmonic, upWind, geometric
+    };
+
     explicit Convective(std::shared_ptr<Props> props,
-                        std::shared_ptr<Sgrid> sgrid);
+                        std::shared_ptr<Sgrid> sgrid,
+                        const std::string &weighing = "meanAverage");
 
     virtual ~Convective() {}
 
     void calcBetas(Eigen::Ref<Eigen::VectorXd> concs);
 
+    template<class Model, class WeighingType>
+    void calcBetasByModel(const Model &model, WeighingType weighingType,
+                          Eigen::Ref<Eigen::VectorXd> concs);
+
     double weighing(const std::string &method, const double &value0,
                     const double &value1);
 
+    void setWeighing(const std::string &weighing);
+
+    std::string getWeighing();
+
+    static Weighing parseWeighing(const std::string &weighing);
+
+    template<Weighing weighingType>
+    static double weigh(const double &value0, const double &value1) {
+
+        if constexpr (weighingType == Weighing::meanAverage)
+            return (value0 + value1) / 2;
+        else if constexpr (weighingType == Weighing::meanHarmonic)
+            return 2. * value0 * value1 / (value0 + value1);
+        else if constexpr (weighingType == Weighing::upWind)
+            return std::max(value0, value1);
+        else
+            return std::sqrt(value0 * value1);
+    }
+
+    // Calls function with std::integral_constant<Weighing, _weighing>, so
+    // face loops are compiled for the configured weighing.
+    template<class Function>
+    auto visitWeighing(Function &&function) {
+
+        switch (_weighing) {
+            case Weighing::meanAverage:
+                return function(std::integral_constant<
+                        Weighing, Weighing::meanAverage>());
+            case Weighing::meanHarmonic:
+                return function(std::integral_constant<
+                        Weighing, Weighing::meanHarmonic>());
+            case Weighing::upWind:
+                return function(std::integral_constant<
+                        Weighing, Weighing::upWind>());
+            default:
+                return function(std::integral_constant<
+                        Weighing, Weighing::geometric>());
+        }
+    }
+
     std::shared_ptr<Props> _props;
     std::shared_ptr<Sgrid> _sgrid;
 
+    Weighing _weighing;
+
     std::vector<double> _betas;
+    // per cell diffusivities evaluated in one batch by calcBetas
+    Eigen::VectorXd _diffusivities;
 
 };
 
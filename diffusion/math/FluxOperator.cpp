@@ -0,0 +1,136 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "FluxOperator.h"
+#include "Models.h"
+#include <stdexcept>
+
+typedef Eigen::Triplet<double> Triplet;
+
+FluxOperator::FluxOperator(std::shared_ptr<Sgrid> sgrid,
+                           const std::map<std::string,
+                                   Eigen::VectorXui64> &groups) :
+        _sgrid(sgrid) {
+
+    uint64_t rowsN = 0;
+    for (auto &[name, faces] : groups)
+        rowsN += faces.size();
+
+    std::vector<Triplet> gradients;
+    std::vector<Triplet> sums;
+    gradients.reserve(2 * rowsN);
+    sums.reserve(rowsN);
+    _cells0.reserve(rowsN);
+    _cells1.reserve(rowsN);
+
+    uint64_t row = 0;
+    for (auto &[name, faces] : groups) {
+        _indices[name] = _names.size();
+        for (Eigen::Index i = 0; i < faces.size(); i++, row++) {
+            auto &face = faces[i];
+            if (face >= _sgrid->_facesN)
+                throw std::invalid_argument(
+                        "FluxOperator: " + name + " face " +
+                        std::to_string(face) + " is out of range");
+
+            auto &neighborsCells = _sgrid->_neighborsCells.at(face);
+            if (neighborsCells.size() < 2)
+                throw std::invalid_argument(
+                        "FluxOperator: " + name + " face " +
+                        std::to_string(face) + " has a single cell, " +
+                        "shift boundary faces inside first");
+            auto &normalsNeighborsCells =
+                    _sgrid->_normalsNeighborsCells.at(face);
+            auto &axis = _sgrid->_facesAxes[face];
+            auto area = _sgrid->_facesSs[axis] / _sgrid->_spacing[axis];
+
+            _cells0.push_back(neighborsCells[0]);
+            _cells1.push_back(neighborsCells[1]);
+            gradients.emplace_back(row, neighborsCells[0],
+                                   -normalsNeighborsCells[0] * area);
+            gradients.emplace_back(row, neighborsCells[1],
+                                   -normalsNeighborsCells[1] * area);
+            sums.emplace_back(_names.size(), row, 1);
+        }
+        _names.push_back(name);
+    }
+
+    _gradients.resize(rowsN, _sgrid->_cellsN);
+    _gradients.setFromTriplets(gradients.begin(), gradients.end());
+    _sums.resize(_names.size(), rowsN);
+    _sums.setFromTriplets(sums.begin(), sums.end());
+}
+
+void FluxOperator::calcFlowRates(
+        Props &props, Convective &convective,
+        const Eigen::Ref<const Eigen::VectorXd> &concsPrev,
+        const Eigen::Ref<const Eigen::VectorXd> &concsCurr,
+        Eigen::Ref<Eigen::VectorXd> flowRates) const {
+
+    if (uint64_t(flowRates.size()) != _names.size())
+        throw std::invalid_argument("FluxOperator: flow rates size " +
+                                    std::to_string(flowRates.size()) +
+                                    " differs from groups number " +
+                                    std::to_string(_names.size()));
+
+    visitModel(props, [&](const auto &model) {
+        convective.visitWeighing([&](auto weighingType) {
+            calcFlowRatesByModel(model, weighingType, props,
+                                 concsPrev, concsCurr, flowRates);
+        });
+    });
+}
+
+Eigen::VectorXd FluxOperator::calcFlowRates(
+        Props &props, Convective &convective,
+        const Eigen::Ref<const Eigen::VectorXd> &concsPrev,
+        const Eigen::Ref<const Eigen::VectorXd> &concsCurr) const {
+
+    Eigen::VectorXd flowRates(_names.size());
+    calcFlowRates(props, convective, concsPrev, concsCurr, flowRates);
+    return flowRates;
+}
+
+template<class Model, class WeighingType>
+void FluxOperator::calcFlowRatesByModel(
+        const Model &model, WeighingType, Props &props,
+        const Eigen::Ref<const Eigen::VectorXd> &concsPrev,
+        const Eigen::Ref<const Eigen::VectorXd> &concsCurr,
+        Eigen::Ref<Eigen::VectorXd> flowRates) const {
+
+    Eigen::VectorXd diffusivities0 = concsPrev(_cells0);
+    Eigen::VectorXd diffusivities1 = concsPrev(_cells1);
+    props.calcD(diffusivities0, diffusivities0);
+    props.calcD(diffusivities1, diffusivities1);
+
+    Eigen::VectorXd fluxes = _gradients * concsCurr;
+    for (Eigen::Index row = 0; row < fluxes.size(); row++) {
+        auto diffusivity = Convective::weigh<WeighingType::value>(
+                diffusivities0[row], diffusivities1[row]);
+        auto conc = Convective::weigh<WeighingType::value>(
+                concsCurr[_cells0[row]], concsCurr[_cells1[row]]);
+        fluxes[row] *= model.b(conc, diffusivity);
+    }
+
+    flowRates = _sums * fluxes;
+}
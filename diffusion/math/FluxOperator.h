@@ -0,0 +1,87 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FLUXOPERATOR_H
+#define FLUXOPERATOR_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include "Props.h"
+#include "Convective.h"
+#include "Solver.h"
+#include <sgrid/Sgrid.h>
+
+// Flow rates through many faces groups in one pass. Built once from the
+// topology: a row per face of every group, _gradients holds the face
+// geometry -(n0 C0 + n1 C1) dS / dL and _sums adds the rows of a group.
+// A call scales the SpMV _gradients C by the face b coefficients and sums
+// them per group; it only reads the operator, so one can be shared.
+class FluxOperator {
+
+public:
+
+    explicit FluxOperator(std::shared_ptr<Sgrid> sgrid,
+                          const std::map<std::string,
+                                  Eigen::VectorXui64> &groups);
+
+    virtual ~FluxOperator() {}
+
+    // flow rates of the groups in _names order, D at concsPrev and the
+    // gradients at concsCurr as in Equation::calcFacesFlowRate
+    void calcFlowRates(Props &props, Convective &convective,
+                       const Eigen::Ref<const Eigen::VectorXd> &concsPrev,
+                       const Eigen::Ref<const Eigen::VectorXd> &concsCurr,
+                       Eigen::Ref<Eigen::VectorXd> flowRates) const;
+
+    Eigen::VectorXd calcFlowRates(
+            Props &props, Convective &convective,
+            const Eigen::Ref<const Eigen::VectorXd> &concsPrev,
+            const Eigen::Ref<const Eigen::VectorXd> &concsCurr) const;
+
+    template<class Model, class WeighingType>
+    void calcFlowRatesByModel(
+            const Model &model, WeighingType weighingType, Props &props,
+            const Eigen::Ref<const Eigen::VectorXd> &concsPrev,
+            const Eigen::Ref<const Eigen::VectorXd> &concsCurr,
+            Eigen::Ref<Eigen::VectorXd> flowRates) const;
+
+    std::shared_ptr<Sgrid> _sgrid;
+
+    std::vector<std::string> _names;
+    std::map<std::string, uint64_t> _indices;
+
+    // neighbour cells of the face rows
+    std::vector<uint64_t> _cells0;
+    std::vector<uint64_t> _cells1;
+    Matrix _gradients;
+    Matrix _sums;
+
+};
+
+#endif // FLUXOPERATOR_H
@@ -22,8 +22,11 @@
  */
 
 #include "Local.h"
-#include "funcs.h"
+#include "Models.h"
+#include "threads.h"
 #include <algorithm>
+#include <cmath>
+#include <limits>
 
 Local::Local(std::shared_ptr<Props> props, std::shared_ptr<Sgrid> sgrid) :
         _props(props),
@@ -32,8 +35,8 @@ Local::Local(std::shared_ptr<Props> props, std::shared_ptr<Sgrid> sgrid) :
 
 void Local::calcTimeSteps() {
 
-    auto time = std::get<double>(_props->_params["time_period"]);
-    auto timeStep = std::get<double>(_props->_params["time_step"]);
+    auto &time = _props->_timePeriod;
+    auto &timeStep = _props->_timeStep;
     double division = time / timeStep;
     double fullStepsN;
     auto lastStep = std::modf(division, &fullStepsN);
@@ -44,13 +47,55 @@ void Local::calcTimeSteps() {
         _timeSteps.push_back(lastStep * timeStep);
 }
 
+bool Local::isAdaptive() {
+    return _props->_timeTolerance > 0;
+}
+
+double Local::calcTimeStepError(
+        const Eigen::Ref<const Eigen::VectorXd> &concs,
+        const Eigen::Ref<const Eigen::VectorXd> &concsPrev,
+        const Eigen::Ref<const Eigen::VectorXd> &concsOld,
+        const double &timeStep, const double &timeStepPrev) {
+
+    auto ratio = timeStep / timeStepPrev;
+    auto errorMax = (concs - concsPrev -
+                     ratio * (concsPrev - concsOld)).lpNorm<Eigen::Infinity>();
+    auto concsMax = std::max(concs.lpNorm<Eigen::Infinity>(),
+                             std::numeric_limits<double>::min());
+
+    return errorMax / (1 + ratio) / concsMax;
+}
+
+double Local::calcTimeStepNext(const double &timeStep, const double &error) {
+
+    // first order method: the error scales with timeStep^2
+    double factor = 2;
+    if (error > 0)
+        factor = std::clamp(0.9 * std::sqrt(_props->_timeTolerance / error),
+                            0.2, 2.);
+
+    return std::clamp(timeStep * factor, _props->_timeStepMin,
+                      _props->_timeStepMax);
+}
+
 void Local::calcAlphas(Eigen::Ref<Eigen::VectorXd> concs,
                        const double &timeStep) {
 
-    auto poroIni = std::get<double>(_props->_params["poro"]);
+    visitModel(*_props, [&](const auto &model) {
+        calcAlphasByModel(model, concs, timeStep);
+    });
+}
+
+template<class Model>
+void Local::calcAlphasByModel(const Model &model,
+                              Eigen::Ref<Eigen::VectorXd> concs,
+                              const double &timeStep) {
+
+    int64_t cellsN = _alphas.size();
 
-    for (int i = 0; i < _alphas.size(); i++) {
-        auto aCoeff = calcAFunc(concs[i], poroIni);
+#pragma omp parallel for num_threads(getThreadsN(cellsN))
+    for (int64_t i = 0; i < cellsN; i++) {
+        auto aCoeff = model.a(concs[i]);
         _alphas[i] = aCoeff * _sgrid->_cellV / timeStep;
     }
 }
\ No newline at end of file
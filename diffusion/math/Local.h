@@ -43,8 +43,26 @@ public:
 
     void calcTimeSteps();
 
+    bool isAdaptive();
+
+    // relative local error of the backward Euler step from concsPrev to
+    // concs, estimated against the linear extrapolation of concsOld and
+    // concsPrev (the step before took timeStepPrev)
+    double calcTimeStepError(const Eigen::Ref<const Eigen::VectorXd> &concs,
+                             const Eigen::Ref<const Eigen::VectorXd> &concsPrev,
+                             const Eigen::Ref<const Eigen::VectorXd> &concsOld,
+                             const double &timeStep,
+                             const double &timeStepPrev);
+
+    // next step after a step with the error, within the props bounds
+    double calcTimeStepNext(const double &timeStep, const double &error);
+
     void calcAlphas(Eigen::Ref<Eigen::VectorXd> concs, const double &timeStep);
 
+    template<class Model>
+    void calcAlphasByModel(const Model &model, Eigen::Ref<Eigen::VectorXd> concs,
+                           const double &timeStep);
+
     std::shared_ptr<Props> _props;
     std::shared_ptr<Sgrid> _sgrid;
 
@@ -0,0 +1,129 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MODELS_H
+#define MODELS_H
+
+#include <stdexcept>
+
+#include "Props.h"
+
+// Constitutive models of the generalised equation a dC/dt - div(b grad C).
+// Every model is built from the compiled Props once per call, so a(C), b(C)
+// and poro(C) inline into the cell and face loops instantiated for it.
+
+// a = poro, b = poro D
+struct LinearModel {
+
+    explicit LinearModel(const Props &props) :
+            _poro(props._porosity),
+            _isConstant(props._DCoeffA == 0) {}
+
+    double poro(const double &) const { return _poro; }
+
+    double a(const double &conc) const { return poro(conc); }
+
+    double b(const double &conc, const double &diffusivity) const {
+        return poro(conc) * diffusivity;
+    }
+
+    double _poro;
+    bool _isConstant;
+
+};
+
+// Single-phase Langmuir only (first_model.tex) with the adsorbed
+// concentration Cs = A B C / (1 + B C) of a single component:
+// a = 1 + (1 - poro) / poro Cs', b = D
+struct LangmuirModel {
+
+    explicit LangmuirModel(const Props &props) :
+            _poro(props._porosity),
+            _langmuirA(props._langmuirA),
+            _langmuirB(props._langmuirB),
+            _isConstant(props._DCoeffA == 0 and
+                        props._langmuirA * props._langmuirB == 0) {}
+
+    double poro(const double &) const { return _poro; }
+
+    double calcAdsorbedDeriv(const double &conc) const {
+        auto denominator = 1 + _langmuirB * conc;
+        return _langmuirA * _langmuirB / (denominator * denominator);
+    }
+
+    double a(const double &conc) const {
+        return 1 + (1 - _poro) / _poro * calcAdsorbedDeriv(conc);
+    }
+
+    double b(const double &, const double &diffusivity) const {
+        return diffusivity;
+    }
+
+    double _poro;
+    double _langmuirA;
+    double _langmuirB;
+    bool _isConstant;
+
+};
+
+// Single-phase Langmuir, Fick and Darcy (third_model.tex) with the
+// effective diffusivity D = Df = Ds and darcy_coeff = R T k / mu:
+// a = poro + (1 - poro) Cs', b = poro (C darcy_coeff + D) + (1 - poro) Cs' D
+struct LangmuirFickModel : LangmuirModel {
+
+    explicit LangmuirFickModel(const Props &props) :
+            LangmuirModel(props),
+            _darcyCoeff(props._darcyCoeff) {
+        _isConstant = _isConstant and _darcyCoeff == 0;
+    }
+
+    double a(const double &conc) const {
+        return _poro + (1 - _poro) * calcAdsorbedDeriv(conc);
+    }
+
+    double b(const double &conc, const double &diffusivity) const {
+        return _poro * (conc * _darcyCoeff + diffusivity) +
+               (1 - _poro) * calcAdsorbedDeriv(conc) * diffusivity;
+    }
+
+    double _darcyCoeff;
+
+};
+
+// Calls function with the model selected in props. The switch runs once per
+// call, the loops inside function are compiled for each model type.
+template<class Function>
+auto visitModel(const Props &props, Function &&function) {
+
+    switch (props._model) {
+        case Props::Model::linear:
+            return function(LinearModel(props));
+        case Props::Model::langmuir:
+            return function(LangmuirModel(props));
+        case Props::Model::langmuirFick:
+            return function(LangmuirFickModel(props));
+    }
+    throw std::invalid_argument("Props: unknown model");
+}
+
+#endif // MODELS_H
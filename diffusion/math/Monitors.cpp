@@ -0,0 +1,116 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Monitors.h"
+#include <stdexcept>
+
+Monitors::Monitors(const uint64_t &facesN, const uint64_t &cellsN) :
+        _facesN(facesN),
+        _cellsN(cellsN),
+        _stepsN(0),
+        _recordedN(0) {}
+
+static void checkIndices(const std::string &name,
+                         const Eigen::Ref<const Eigen::VectorXui64> &indices,
+                         const uint64_t &indicesN) {
+    for (Eigen::Index i = 0; i < indices.size(); i++)
+        if (indices[i] >= indicesN)
+            throw std::invalid_argument("Monitors: " + name + " index " +
+                                        std::to_string(indices[i]) +
+                                        " is out of range");
+}
+
+void Monitors::addFaces(const std::string &name,
+                        const Eigen::Ref<const Eigen::VectorXui64> &faces) {
+    checkIndices(name, faces, _facesN);
+    _faces[name] = faces;
+    _flowRates.erase(name);
+}
+
+void Monitors::addCells(const std::string &name,
+                        const Eigen::Ref<const Eigen::VectorXui64> &cells) {
+    checkIndices(name, cells, _cellsN);
+    _cells[name] = cells;
+    _concs.erase(name);
+}
+
+void Monitors::clear() {
+    _faces.clear();
+    _cells.clear();
+    allocate(0);
+}
+
+bool Monitors::isEmpty() {
+    return _faces.empty() and _cells.empty();
+}
+
+void Monitors::allocate(const uint64_t &stepsN) {
+
+    _stepsN = stepsN;
+    _recordedN = 0;
+    _times.resize(_stepsN);
+
+    _flowRates.clear();
+    for (auto &[name, faces] : _faces)
+        _flowRates[name].resize(_stepsN);
+
+    _concs.clear();
+    for (auto &[name, cells] : _cells)
+        _concs[name].resize(_stepsN, cells.size());
+}
+
+void Monitors::reserve(const uint64_t &stepsN) {
+
+    if (stepsN <= _stepsN)
+        return;
+
+    _stepsN = stepsN;
+    _times.conservativeResize(_stepsN);
+    for (auto &[name, flowRates] : _flowRates)
+        flowRates.conservativeResize(_stepsN);
+    for (auto &[name, concs] : _concs)
+        concs.conservativeResize(_stepsN, Eigen::NoChange);
+}
+
+uint64_t Monitors::push(const double &time) {
+
+    if (_recordedN == _stepsN)
+        throw std::runtime_error("Monitors: all steps are recorded");
+
+    _times[_recordedN] = time;
+    return _recordedN++;
+}
+
+Eigen::Map<Eigen::VectorXd> Monitors::getTimes() {
+    return Eigen::Map<Eigen::VectorXd>(_times.data(), _recordedN);
+}
+
+Eigen::Map<Eigen::VectorXd> Monitors::getFlowRates(const std::string &name) {
+    return Eigen::Map<Eigen::VectorXd>(_flowRates.at(name).data(),
+                                       _recordedN);
+}
+
+Eigen::Map<RowMatrix> Monitors::getConcs(const std::string &name) {
+    auto &concs = _concs.at(name);
+    return Eigen::Map<RowMatrix>(concs.data(), _recordedN, concs.cols());
+}
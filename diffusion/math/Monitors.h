@@ -0,0 +1,88 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MONITORS_H
+#define MONITORS_H
+
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+#include "Snapshots.h"
+#include <sgrid/Sgrid.h>
+
+// Quantities recorded by cfdProcedure after every step: the flow rate
+// through each registered faces group and the concentrations of each
+// registered cells group. Rows for all steps of a run are allocated before
+// it, a row per step, and grown by reserve for runs of unknown length.
+class Monitors {
+
+public:
+
+    explicit Monitors(const uint64_t &facesN, const uint64_t &cellsN);
+
+    virtual ~Monitors() {}
+
+    void addFaces(const std::string &name,
+                  const Eigen::Ref<const Eigen::VectorXui64> &faces);
+
+    void addCells(const std::string &name,
+                  const Eigen::Ref<const Eigen::VectorXui64> &cells);
+
+    void clear();
+
+    bool isEmpty();
+
+    // rows for stepsN steps, the records of a previous run are dropped
+    void allocate(const uint64_t &stepsN);
+
+    // rows for at least stepsN steps, the recorded ones are kept
+    void reserve(const uint64_t &stepsN);
+
+    // records time and returns the row of the step
+    uint64_t push(const double &time);
+
+    Eigen::Map<Eigen::VectorXd> getTimes();
+
+    Eigen::Map<Eigen::VectorXd> getFlowRates(const std::string &name);
+
+    Eigen::Map<RowMatrix> getConcs(const std::string &name);
+
+    uint64_t _facesN;
+    uint64_t _cellsN;
+
+    std::map<std::string, Eigen::VectorXui64> _faces;
+    std::map<std::string, Eigen::VectorXui64> _cells;
+
+    uint64_t _stepsN;
+    uint64_t _recordedN;
+    Eigen::VectorXd _times;
+    std::map<std::string, Eigen::VectorXd> _flowRates;
+    std::map<std::string, RowMatrix> _concs;
+
+};
+
+#endif // MONITORS_H
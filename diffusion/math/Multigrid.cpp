@@ -0,0 +1,247 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Multigrid.h"
+#include <stdexcept>
+
+Multigrid::Multigrid(const std::string &smoother) :
+        _smoother(smoother),
+        _sweepsN(2),
+        _jacobiWeight(2. / 3.),
+        _coarsestCellsN(4096),
+        _fine(nullptr),
+        _info(Eigen::Success) {
+
+    if (_smoother != "gauss_seidel" and _smoother != "jacobi")
+        throw std::invalid_argument("Multigrid: unknown smoother " + _smoother);
+}
+
+const Stencil &Multigrid::level(const int &i) const {
+    return i == 0 ? *_fine : _levels[i - 1];
+}
+
+Multigrid &Multigrid::analyzePattern(const Stencil &stencil) {
+
+    _fine = &stencil;
+    _levels.clear();
+    _cellsN = {uint64_t(stencil._diag.size())};
+
+    auto cellsDims = stencil._cellsDims;
+    while (_cellsN.back() > _coarsestCellsN and
+           (cellsDims[0] > 1 or cellsDims[1] > 1 or cellsDims[2] > 1)) {
+        for (auto &cellsDim : cellsDims)
+            cellsDim = (cellsDim + 1) / 2;
+        _levels.emplace_back(cellsDims);
+        _cellsN.push_back(cellsDims[0] * cellsDims[1] * cellsDims[2]);
+    }
+
+    auto levelsN = _cellsN.size();
+    _aggregates.resize(levelsN - 1);
+    for (uint64_t i = 0; i < levelsN - 1; i++)
+        _aggregates[i].resize(_cellsN[i]);
+
+    _freeVectors.resize(levelsN);
+    _residuals.resize(levelsN);
+    _corrections.resize(levelsN);
+    for (uint64_t i = 0; i < levelsN; i++) {
+        _freeVectors[i].resize(_cellsN[i]);
+        _residuals[i].resize(_cellsN[i]);
+        _corrections[i].resize(_cellsN[i]);
+    }
+
+    return *this;
+}
+
+Multigrid &Multigrid::factorize(const Stencil &stencil) {
+
+    if (_fine != &stencil or _cellsN.empty() or
+        _cellsN[0] != uint64_t(stencil._diag.size()))
+        analyzePattern(stencil);
+
+    auto levelsN = _cellsN.size();
+    for (uint64_t i = 0; i < levelsN - 1; i++) {
+        auto &fine = level(i);
+        auto &coarse = _levels[i];
+        auto &aggregates = _aggregates[i];
+        auto &cellsN = _cellsN[i];
+
+        std::vector<bool> isCoupled(cellsN, false);
+        for (uint8_t axis = 0; axis < 3; axis++) {
+            auto &stride = fine._strides[axis];
+            if (stride == 0)
+                continue;
+            for (uint64_t cell = 0; cell < cellsN - stride; cell++)
+                if (fine._couplings[axis][cell] != 0) {
+                    isCoupled[cell] = true;
+                    isCoupled[cell + stride] = true;
+                }
+        }
+
+        for (uint64_t cell = 0; cell < cellsN; cell++) {
+            if (!isCoupled[cell] or fine._diag[cell] == 0) {
+                aggregates[cell] = -1;
+                continue;
+            }
+            int64_t aggregate = 0;
+            for (uint8_t axis = 0; axis < 3; axis++) {
+                auto &stride = fine._strides[axis];
+                if (stride == 0)
+                    continue;
+                auto coord = (cell / stride) % fine._cellsDims[axis];
+                aggregate += (coord / 2) * coarse._strides[axis];
+            }
+            aggregates[cell] = aggregate;
+        }
+
+        // Galerkin product of the piecewise constant prolongation
+        coarse.setZero();
+        for (uint64_t cell = 0; cell < cellsN; cell++)
+            if (aggregates[cell] >= 0)
+                coarse._diag[aggregates[cell]] += fine._diag[cell];
+
+        for (uint8_t axis = 0; axis < 3; axis++) {
+            auto &stride = fine._strides[axis];
+            if (stride == 0)
+                continue;
+            for (uint64_t cell = 0; cell < cellsN - stride; cell++) {
+                auto &coupling = fine._couplings[axis][cell];
+                if (coupling == 0)
+                    continue;
+                auto &aggregate0 = aggregates[cell];
+                auto &aggregate1 = aggregates[cell + stride];
+                if (aggregate0 == aggregate1)
+                    coarse._diag[aggregate0] -= 2 * coupling;
+                else
+                    coarse._couplings[axis][aggregate0] += coupling;
+            }
+        }
+    }
+
+    auto &coarsest = level(levelsN - 1);
+    auto &cellsN = _cellsN.back();
+    std::vector<Eigen::Triplet<double>> triplets;
+    for (uint64_t cell = 0; cell < cellsN; cell++) {
+        auto &diag = coarsest._diag[cell];
+        triplets.emplace_back(cell, cell, diag != 0 ? diag : 1);
+    }
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        auto &stride = coarsest._strides[axis];
+        if (stride == 0)
+            continue;
+        for (uint64_t cell = 0; cell < cellsN - stride; cell++) {
+            auto &coupling = coarsest._couplings[axis][cell];
+            if (coupling == 0)
+                continue;
+            triplets.emplace_back(cell, cell + stride, -coupling);
+            triplets.emplace_back(cell + stride, cell, -coupling);
+        }
+    }
+    Eigen::SparseMatrix<double> matrix(cellsN, cellsN);
+    matrix.setFromTriplets(triplets.begin(), triplets.end());
+    _coarsest.compute(matrix);
+    _info = _coarsest.info();
+
+    return *this;
+}
+
+Multigrid &Multigrid::compute(const Stencil &stencil) {
+
+    analyzePattern(stencil);
+    return factorize(stencil);
+}
+
+void Multigrid::cycle(const int &i, Eigen::Ref<Eigen::VectorXd> x) const {
+
+    auto &freeVector = _freeVectors[i];
+
+    if (uint64_t(i) == _cellsN.size() - 1) {
+        x = _coarsest.solve(freeVector);
+        return;
+    }
+
+    auto &stencil = level(i);
+    auto &aggregates = _aggregates[i];
+    auto &residual = _residuals[i];
+
+    smooth(i, x, false);
+
+    residual = freeVector;
+    stencil.applyAdd(x, residual, -1);
+
+    auto &coarseFreeVector = _freeVectors[i + 1];
+    coarseFreeVector.setZero();
+    for (uint64_t cell = 0; cell < _cellsN[i]; cell++)
+        if (aggregates[cell] >= 0)
+            coarseFreeVector[aggregates[cell]] += residual[cell];
+
+    auto &correction = _corrections[i + 1];
+    correction.setZero();
+    cycle(i + 1, correction);
+
+    for (uint64_t cell = 0; cell < _cellsN[i]; cell++)
+        if (aggregates[cell] >= 0)
+            x[cell] += correction[aggregates[cell]];
+
+    smooth(i, x, true);
+}
+
+// Forward Gauss-Seidel before and backward after the coarse correction
+// keep the V-cycle symmetric, as conjugate gradients need.
+void Multigrid::smooth(const int &i, Eigen::Ref<Eigen::VectorXd> x,
+                       const bool &isBackward) const {
+
+    auto &stencil = level(i);
+    auto &freeVector = _freeVectors[i];
+    auto &diag = stencil._diag;
+    int64_t cellsN = _cellsN[i];
+
+    if (_smoother == "jacobi") {
+        auto &residual = _residuals[i];
+        for (int sweep = 0; sweep < _sweepsN; sweep++) {
+            residual = freeVector;
+            stencil.applyAdd(x, residual, -1);
+            x.array() += _jacobiWeight * (diag.array() != 0).select(
+                    residual.array() / diag.array(), 0.);
+        }
+        return;
+    }
+
+    for (int sweep = 0; sweep < _sweepsN; sweep++)
+        for (int64_t j = 0; j < cellsN; j++) {
+            auto cell = isBackward ? cellsN - 1 - j : j;
+            if (diag[cell] == 0)
+                continue;
+            auto sum = freeVector[cell];
+            for (uint8_t axis = 0; axis < 3; axis++) {
+                int64_t stride = stencil._strides[axis];
+                if (stride == 0)
+                    continue;
+                auto &couplings = stencil._couplings[axis];
+                if (cell + stride < cellsN)
+                    sum += couplings[cell] * x[cell + stride];
+                if (cell >= stride)
+                    sum += couplings[cell - stride] * x[cell - stride];
+            }
+            x[cell] = sum / diag[cell];
+        }
+}
@@ -0,0 +1,111 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef MULTIGRID_H
+#define MULTIGRID_H
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include "Stencil.h"
+
+// Geometric multigrid V-cycle preconditioner of a Stencil. Coarse levels
+// merge 2x2x2 blocks of cells of the level above and take the Galerkin
+// operator of the piecewise constant prolongation. Cells without any
+// coupling (inactive cells of an image mask, Dirichlet cells) are kept
+// out of the blocks and are handled exactly by the smoother, so they do
+// not dilute the coarse operators.
+class Multigrid {
+
+public:
+
+    explicit Multigrid(const std::string &smoother = "gauss_seidel");
+
+    virtual ~Multigrid() {}
+
+    Eigen::Index rows() const { return _cellsN.empty() ? 0 : _cellsN[0]; }
+
+    Eigen::Index cols() const { return rows(); }
+
+    Multigrid &analyzePattern(const Stencil &stencil);
+
+    Multigrid &factorize(const Stencil &stencil);
+
+    Multigrid &compute(const Stencil &stencil);
+
+    // the result is kept in the finest level correction, which the cycle
+    // leaves unused, until the next application
+    template<typename Rhs>
+    const Eigen::VectorXd &solve(const Eigen::MatrixBase<Rhs> &b) const {
+        auto &x = _corrections[0];
+        x.setZero();
+        _freeVectors[0] = b;
+        cycle(0, x);
+        return x;
+    }
+
+    Eigen::ComputationInfo info() { return _info; }
+
+    std::string _smoother;
+    int _sweepsN;
+    double _jacobiWeight;
+    uint64_t _coarsestCellsN;
+
+private:
+
+    const Stencil &level(const int &i) const;
+
+    void cycle(const int &i, Eigen::Ref<Eigen::VectorXd> x) const;
+
+    void smooth(const int &i, Eigen::Ref<Eigen::VectorXd> x,
+                const bool &isBackward) const;
+
+    const Stencil *_fine;
+    std::vector<Stencil> _levels;
+    std::vector<uint64_t> _cellsN;
+    std::vector<std::vector<int64_t>> _aggregates;
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> _coarsest;
+    Eigen::ComputationInfo _info;
+
+    mutable std::vector<Eigen::VectorXd> _freeVectors;
+    mutable std::vector<Eigen::VectorXd> _residuals;
+    mutable std::vector<Eigen::VectorXd> _corrections;
+
+};
+
+// Multigrid with weighted Jacobi smoothing, selectable as a separate
+// Eigen preconditioner type
+class MultigridJacobi : public Multigrid {
+
+public:
+
+    MultigridJacobi() : Multigrid("jacobi") {}
+
+};
+
+#endif // MULTIGRID_H
@@ -23,19 +23,101 @@
 
 
 #include "Props.h"
+#include <stdexcept>
 #include <vector>
 
 
-Props::Props(const std::map<std::string, std::variant<double, int>> &params)
+static const std::map<std::string, Props::Model> modelsNames{
+        {"linear",        Props::Model::linear},
+        {"langmuir",      Props::Model::langmuir},
+        {"langmuir_fick", Props::Model::langmuirFick}};
 
-        : _params(params) {}
+Props::Props(const std::map<std::string, std::variant<double, int>> &params,
+             const std::string &model)
+
+        : _params(params) {
+
+    setModel(model);
+    compileParams();
+}
+
+void Props::setModel(const std::string &model) {
+
+    auto it = modelsNames.find(model);
+    if (it == modelsNames.end())
+        throw std::invalid_argument("Props: unknown model " + model);
+    _model = it->second;
+}
+
+std::string Props::getModel() {
+
+    for (auto &[name, model] : modelsNames)
+        if (model == _model)
+            return name;
+    return "";
+}
+
+void Props::setParams(
+        const std::map<std::string, std::variant<double, int>> &params) {
+
+    _params = params;
+    compileParams();
+}
+
+static double getParam(
+        const std::map<std::string, std::variant<double, int>> &params,
+        const std::string &name, const bool &isRequired = true) {
+
+    auto it = params.find(name);
+    if (it == params.end() and !isRequired)
+        return 0;
+    else if (it == params.end())
+        throw std::invalid_argument("Props: missing parameter " + name);
+
+    if (auto value = std::get_if<int>(&it->second))
+        return *value;
+    return std::get<double>(it->second);
+}
+
+void Props::compileParams() {
+
+    _timePeriod = getParam(_params, "time_period");
+    _timeStep = getParam(_params, "time_step");
+    _DCoeffA = getParam(_params, "d_coeff_a");
+    _DCoeffB = getParam(_params, "d_coeff_b");
+    _porosity = getParam(_params, "poro");
+    _langmuirA = getParam(_params, "langmuir_a", false);
+    _langmuirB = getParam(_params, "langmuir_b", false);
+    _darcyCoeff = getParam(_params, "darcy_coeff", false);
+
+    _timeTolerance = getParam(_params, "time_tolerance", false);
+    _timeStepMin = _params.count("time_step_min") ?
+                   getParam(_params, "time_step_min") : _timeStep;
+    _timeStepMax = _params.count("time_step_max") ?
+                   getParam(_params, "time_step_max") : _timePeriod;
+    _picardTolerance = getParam(_params, "picard_tolerance", false);
+    _picardIterationsMax = _params.count("picard_iterations_max") ?
+                           getParam(_params, "picard_iterations_max") : 20;
+    if (_picardIterationsMax < 1)
+        throw std::invalid_argument(
+                "Props: picard_iterations_max must be positive");
+
+    if (_timeTolerance > 0 and
+        (_timeStepMin <= 0 or _timeStepMin > _timeStepMax))
+        throw std::invalid_argument(
+                "Props: time_step_min must be positive and not above "
+                "time_step_max");
+}
 
 double Props::calcD(const double &conc) {
 
-    auto DCoeffA = std::get<double>(_params["d_coeff_a"]);
-    auto DCoeffB = std::get<double>(_params["d_coeff_b"]);
+    return _DCoeffA * conc + _DCoeffB;
+}
+
+void Props::calcD(const Eigen::Ref<const Eigen::VectorXd> &concs,
+                  Eigen::Ref<Eigen::VectorXd> diffusivities) {
 
-    return DCoeffA * conc + DCoeffB;
+    diffusivities.array() = _DCoeffA * concs.array() + _DCoeffB;
 }
 
 void Props::printParams() {
@@ -30,24 +30,61 @@
 #include <variant>
 #include <vector>
 
+#include <Eigen/Dense>
+
 class Props {
 
 public:
     // ToDo: class Props as map, calcD to Convective
-    explicit Props(const std::map<std::string, std::variant<double, int>> &params);
+    explicit Props(const std::map<std::string, std::variant<double, int>> &params,
+                   const std::string &model = "linear");
 
     virtual ~Props() {}
 
+    // constitutive models, see Models.h
+    enum class Model {
+        linear, langmuir, langmuirFick
+    };
+
     std::map<std::string, std::variant<double, int>> _params;
+    Model _model;
 
+    // compiled copies of _params, refreshed by setParams and compileParams
     double _timePeriod;
     double _timeStep;
     double _DCoeffA;
     double _DCoeffB;
     double _porosity;
+    // optional, zero if not given
+    double _langmuirA;
+    double _langmuirB;
+    double _darcyCoeff;
+    // adaptive time stepping is on for a positive time_tolerance,
+    // steps are bounded by time_step_min (time_step if not given) and
+    // time_step_max (time_period if not given)
+    double _timeTolerance;
+    double _timeStepMin;
+    double _timeStepMax;
+    // Picard iterations of the coefficients within a time step are on for
+    // a positive picard_tolerance, at most picard_iterations_max (20 if
+    // not given) linear solves per step
+    double _picardTolerance;
+    int _picardIterationsMax;
+
+    void setModel(const std::string &model);
+
+    std::string getModel();
+
+    void setParams(const std::map<std::string, std::variant<double, int>> &params);
+
+    // call after editing _params in place
+    void compileParams();
 
     double calcD(const double &conc);
 
+    void calcD(const Eigen::Ref<const Eigen::VectorXd> &concs,
+               Eigen::Ref<Eigen::VectorXd> diffusivities);
+
     void printParams();
 
 private:
@@ -0,0 +1,140 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Snapshots.h"
+#include <algorithm>
+#include <stdexcept>
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+Snapshots::Snapshots(const uint64_t &snapshotsN, const uint64_t &cellsN,
+                     const std::string &path) :
+        _snapshotsN(snapshotsN),
+        _cellsN(cellsN),
+        _savedN(0),
+        _path(path),
+        _data(nullptr),
+        _file(-1),
+        _mappedSize(0) {
+
+    _times.reserve(_snapshotsN);
+    auto size = _snapshotsN * _cellsN;
+
+    if (_path.empty()) {
+        _buffer.reset(new double[size]);
+        _data = _buffer.get();
+        return;
+    }
+
+    // a new file replaces the one at path, a store of an earlier run
+    // mapping that one keeps it until it is released
+    auto pathTemp = _path + ".XXXXXX";
+    _file = mkstemp(pathTemp.data());
+    if (_file < 0)
+        throw std::runtime_error("Snapshots: can not open " + _path);
+    if (fchmod(_file, 0644) != 0 or
+        rename(pathTemp.c_str(), _path.c_str()) != 0) {
+        unlink(pathTemp.c_str());
+        close(_file);
+        throw std::runtime_error("Snapshots: can not create " + _path);
+    }
+
+    if (size == 0)
+        return;
+
+    try {
+        _data = mapFile(size * sizeof(double));
+    } catch (...) {
+        close(_file);
+        throw;
+    }
+    _mappedSize = size * sizeof(double);
+}
+
+Snapshots::~Snapshots() {
+    if (_mappedSize)
+        munmap(_data, _mappedSize);
+    if (_file >= 0)
+        close(_file);
+}
+
+double *Snapshots::mapFile(const size_t &size) {
+
+    if (ftruncate(_file, size) != 0)
+        throw std::runtime_error("Snapshots: can not resize " + _path);
+
+    auto data = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, _file, 0);
+    if (data == MAP_FAILED)
+        throw std::runtime_error("Snapshots: can not map " + _path);
+    return static_cast<double *>(data);
+}
+
+void Snapshots::reserve(const uint64_t &snapshotsN) {
+
+    if (snapshotsN <= _snapshotsN)
+        return;
+
+    _times.reserve(snapshotsN);
+    auto size = snapshotsN * _cellsN;
+
+    if (_path.empty()) {
+        std::unique_ptr<double[]> buffer(new double[size]);
+        std::copy(_data, _data + _savedN * _cellsN, buffer.get());
+        _buffer = std::move(buffer);
+        _data = _buffer.get();
+    } else if (size != 0) {
+        // the saved rows stay in the file, which is only extended
+        auto data = mapFile(size * sizeof(double));
+        if (_mappedSize)
+            munmap(_data, _mappedSize);
+        _data = data;
+        _mappedSize = size * sizeof(double);
+    }
+
+    _snapshotsN = snapshotsN;
+}
+
+void Snapshots::push(const double &time,
+                     const Eigen::Ref<const Eigen::VectorXd> &concs) {
+
+    if (_savedN == _snapshotsN)
+        throw std::runtime_error("Snapshots: all snapshots are saved");
+
+    getConcs(_savedN) = concs;
+    _times.push_back(time);
+    _savedN++;
+}
+
+Eigen::Map<RowMatrix> Snapshots::getConcs() {
+    return Eigen::Map<RowMatrix>(_data, _savedN, _cellsN);
+}
+
+Eigen::Map<Eigen::VectorXd> Snapshots::getConcs(const uint64_t &snapshot) {
+    return Eigen::Map<Eigen::VectorXd>(_data + snapshot * _cellsN, _cellsN);
+}
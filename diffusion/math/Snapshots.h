@@ -0,0 +1,87 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SNAPSHOTS_H
+#define SNAPSHOTS_H
+
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <Eigen/Dense>
+
+typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic,
+        Eigen::RowMajor> RowMatrix;
+
+// Concentration history of a run: snapshotsN rows of cellsN values
+// allocated up front, in memory or, with a non-empty path, in a file mapped
+// into memory so long histories are paged to disk. Every store creates a
+// new file at path, so the data of stores still alive is never
+// overwritten. reserve grows the rows for runs of unknown length.
+class Snapshots {
+
+public:
+
+    explicit Snapshots(const uint64_t &snapshotsN, const uint64_t &cellsN,
+                       const std::string &path = "");
+
+    virtual ~Snapshots();
+
+    Snapshots(const Snapshots &) = delete;
+
+    Snapshots &operator=(const Snapshots &) = delete;
+
+    // at least snapshotsN rows, the saved ones are kept
+    void reserve(const uint64_t &snapshotsN);
+
+    void push(const double &time,
+              const Eigen::Ref<const Eigen::VectorXd> &concs);
+
+    // the snapshots pushed so far, one per row
+    Eigen::Map<RowMatrix> getConcs();
+
+    Eigen::Map<Eigen::VectorXd> getConcs(const uint64_t &snapshot);
+
+    uint64_t _snapshotsN;
+    uint64_t _cellsN;
+    uint64_t _savedN;
+    std::string _path;
+    std::vector<double> _times;
+
+private:
+
+    // maps _file resized to size bytes
+    double *mapFile(const size_t &size);
+
+    double *_data;
+    // left uninitialized, so pages of unused rows are never touched
+    std::unique_ptr<double[]> _buffer;
+    // open for the store lifetime, so reserve extends this store's file
+    // even once a later store has replaced it at _path
+    int _file;
+    size_t _mappedSize;
+
+};
+
+#endif // SNAPSHOTS_H
@@ -0,0 +1,358 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Solver.h"
+#include "Multigrid.h"
+#include <set>
+#include <stdexcept>
+#include <unsupported/Eigen/IterativeSolvers>
+
+class SolverBackend {
+
+public:
+
+    virtual ~SolverBackend() {}
+
+    virtual void analyzePattern(const Matrix &) { throwOperator(); }
+
+    virtual void factorize(const Matrix &) { throwOperator(); }
+
+    virtual void analyzePattern(const Stencil &) { throwOperator(); }
+
+    virtual void factorize(const Stencil &) { throwOperator(); }
+
+    virtual bool solve(const Eigen::Ref<const Eigen::VectorXd> &freeVector,
+                       const Eigen::Ref<const Eigen::VectorXd> &guess,
+                       Eigen::Ref<Eigen::VectorXd> solution) = 0;
+
+    virtual void setControls(const double &tolerance,
+                             const int &iterationsMax) = 0;
+
+    virtual int iterations() = 0;
+
+    virtual double error() = 0;
+
+    virtual bool isIterative() = 0;
+
+private:
+
+    void throwOperator() {
+        throw std::invalid_argument(
+                "Solver: method and preconditioner do not support "
+                "this operator");
+    }
+
+};
+
+template<class IterativeSolver>
+class IterativeBackend : public SolverBackend {
+
+public:
+
+    typedef typename IterativeSolver::MatrixType Operator;
+
+    using SolverBackend::analyzePattern;
+    using SolverBackend::factorize;
+
+    void analyzePattern(const Operator &matrix) override {
+        _solver.analyzePattern(matrix);
+    }
+
+    void factorize(const Operator &matrix) override {
+        _solver.factorize(matrix);
+    }
+
+    bool solve(const Eigen::Ref<const Eigen::VectorXd> &freeVector,
+               const Eigen::Ref<const Eigen::VectorXd> &guess,
+               Eigen::Ref<Eigen::VectorXd> solution) override {
+        solution = _solver.solveWithGuess(freeVector, guess);
+        return _solver.info() == Eigen::Success;
+    }
+
+    void setControls(const double &tolerance,
+                     const int &iterationsMax) override {
+        _solver.setTolerance(tolerance);
+        _solver.setMaxIterations(iterationsMax);
+    }
+
+    int iterations() override { return _solver.iterations(); }
+
+    double error() override { return _solver.error(); }
+
+    bool isIterative() override { return true; }
+
+    IterativeSolver _solver;
+
+};
+
+// Sparse Cholesky of the symmetric positive definite system. analyzePattern
+// runs on compute only, once per pattern (Equation invalidates the Solver
+// when it rebuilds the compact system), and every update is a numeric
+// factorization only.
+template<class DirectSolver>
+class DirectBackend : public SolverBackend {
+
+public:
+
+    using SolverBackend::analyzePattern;
+    using SolverBackend::factorize;
+
+    void analyzePattern(const Matrix &matrix) override {
+        _solver.analyzePattern(matrix);
+    }
+
+    void factorize(const Matrix &matrix) override {
+        _solver.factorize(matrix);
+    }
+
+    bool solve(const Eigen::Ref<const Eigen::VectorXd> &freeVector,
+               const Eigen::Ref<const Eigen::VectorXd> &,
+               Eigen::Ref<Eigen::VectorXd> solution) override {
+        if (_solver.info() != Eigen::Success)
+            return false;
+        solution = _solver.solve(freeVector);
+        return _solver.info() == Eigen::Success;
+    }
+
+    void setControls(const double &, const int &) override {}
+
+    int iterations() override { return 0; }
+
+    double error() override { return 0; }
+
+    bool isIterative() override { return false; }
+
+    DirectSolver _solver;
+
+};
+
+template<class Operator, class Preconditioner>
+using BiCGSTAB = Eigen::BiCGSTAB<Operator, Preconditioner>;
+
+template<class Operator, class Preconditioner>
+using ConjugateGradient = Eigen::ConjugateGradient<Operator,
+        Eigen::Lower | Eigen::Upper, Preconditioner>;
+
+template<class Operator, class Preconditioner>
+using GMRES = Eigen::GMRES<Operator, Preconditioner>;
+
+template<template<class, class> class Method>
+std::unique_ptr<SolverBackend>
+createIterativeBackend(const std::string &preconditioner,
+                       const bool &isMatrixFree) {
+
+    if (isMatrixFree and preconditioner == "jacobi")
+        return std::make_unique<IterativeBackend<
+                Method<Stencil, StencilJacobi>>>();
+    else if (isMatrixFree and preconditioner == "multigrid")
+        return std::make_unique<IterativeBackend<
+                Method<Stencil, Multigrid>>>();
+    else if (isMatrixFree and preconditioner == "multigrid_jacobi")
+        return std::make_unique<IterativeBackend<
+                Method<Stencil, MultigridJacobi>>>();
+    else if (isMatrixFree)
+        throw std::invalid_argument("Solver: preconditioner " +
+                                    preconditioner +
+                                    " needs an assembled matrix");
+    else if (preconditioner == "jacobi")
+        return std::make_unique<IterativeBackend<
+                Method<Matrix, Eigen::DiagonalPreconditioner<double>>>>();
+    else if (preconditioner == "ilut")
+        return std::make_unique<IterativeBackend<
+                Method<Matrix, Eigen::IncompleteLUT<double>>>>();
+    else if (preconditioner == "ichol")
+        return std::make_unique<IterativeBackend<
+                Method<Matrix, Eigen::IncompleteCholesky<double>>>>();
+    else if (preconditioner == "multigrid" or
+             preconditioner == "multigrid_jacobi")
+        throw std::invalid_argument("Solver: preconditioner " +
+                                    preconditioner + " needs matrix_free");
+    else
+        throw std::invalid_argument(
+                "Solver: unknown preconditioner " + preconditioner);
+}
+
+std::unique_ptr<SolverBackend>
+createBackend(const std::string &method, const std::string &preconditioner,
+              const bool &isMatrixFree) {
+
+    if (method == "bicgstab")
+        return createIterativeBackend<BiCGSTAB>(preconditioner,
+                                                isMatrixFree);
+    else if (method == "cg")
+        return createIterativeBackend<ConjugateGradient>(preconditioner,
+                                                         isMatrixFree);
+    else if (method == "gmres")
+        return createIterativeBackend<GMRES>(preconditioner, isMatrixFree);
+    else if (isMatrixFree)
+        throw std::invalid_argument(
+                "Solver: method " + method + " needs an assembled matrix");
+    else if (method == "ldlt")
+        return std::make_unique<DirectBackend<Eigen::SimplicialLDLT<Matrix>>>();
+    else if (method == "llt")
+        return std::make_unique<DirectBackend<Eigen::SimplicialLLT<Matrix>>>();
+    else
+        throw std::invalid_argument("Solver: unknown method " + method);
+}
+
+Solver::Solver(const std::string &method,
+               const std::string &preconditioner) :
+        _method(method),
+        _preconditioner(preconditioner),
+        _tolerance(Eigen::NumTraits<double>::epsilon()),
+        _iterationsMax(-1),
+        _refreshPeriod(1),
+        _refreshGrowth(1.5),
+        _iterations(0),
+        _error(0),
+        _isConverged(true),
+        _refreshesN(0),
+        _matrix(nullptr),
+        _stencil(nullptr),
+        _values(nullptr),
+        _updatesN(0),
+        _iterationsRefresh(-1),
+        _isRefreshNeeded(false) {
+
+    std::set<std::string> methods{"bicgstab", "cg", "gmres", "ldlt", "llt"};
+    std::set<std::string> preconditioners{"jacobi", "ilut", "ichol",
+                                          "multigrid", "multigrid_jacobi"};
+    if (!methods.count(_method))
+        throw std::invalid_argument("Solver: unknown method " + _method);
+    if (!preconditioners.count(_preconditioner))
+        throw std::invalid_argument(
+                "Solver: unknown preconditioner " + _preconditioner);
+}
+
+Solver::~Solver() {}
+
+void Solver::compute(const Matrix &matrix) {
+
+    if (!_backend or _stencil)
+        _backend = createBackend(_method, _preconditioner, false);
+    _matrix = &matrix;
+    _stencil = nullptr;
+    _values = matrix.valuePtr();
+    _backend->analyzePattern(matrix);
+    refresh();
+}
+
+void Solver::compute(const Stencil &stencil) {
+
+    if (!_backend or !_stencil)
+        _backend = createBackend(_method, _preconditioner, true);
+    _matrix = nullptr;
+    _stencil = &stencil;
+    _values = stencil._diag.data();
+    _backend->analyzePattern(stencil);
+    refresh();
+}
+
+bool Solver::isComputed(const Matrix &matrix) {
+    return _matrix == &matrix and _values == matrix.valuePtr();
+}
+
+bool Solver::isComputed(const Stencil &stencil) {
+    return _stencil == &stencil and _values == stencil._diag.data();
+}
+
+void Solver::invalidate() {
+    _values = nullptr;
+}
+
+void Solver::update(const Matrix &matrix) {
+
+    if (!isComputed(matrix))
+        compute(matrix);
+    else
+        update();
+}
+
+void Solver::update(const Stencil &stencil) {
+
+    if (!isComputed(stencil))
+        compute(stencil);
+    else
+        update();
+}
+
+void Solver::updateValues(const Matrix &matrix) {
+
+    if (!isComputed(matrix))
+        compute(matrix);
+    else if (!_backend->isIterative() or _isRefreshNeeded)
+        refresh();
+}
+
+void Solver::updateValues(const Stencil &stencil) {
+
+    if (!isComputed(stencil))
+        compute(stencil);
+    else if (!_backend->isIterative() or _isRefreshNeeded)
+        refresh();
+}
+
+void Solver::update() {
+
+    _updatesN++;
+    if (!_backend->isIterative() or _isRefreshNeeded or
+        _updatesN >= _refreshPeriod)
+        refresh();
+}
+
+void Solver::refresh() {
+
+    if (_stencil)
+        _backend->factorize(*_stencil);
+    else
+        _backend->factorize(*_matrix);
+    _updatesN = 0;
+    _iterationsRefresh = -1;
+    _isRefreshNeeded = false;
+    _refreshesN++;
+}
+
+void Solver::solve(const Eigen::Ref<const Eigen::VectorXd> &freeVector,
+                   const Eigen::Ref<const Eigen::VectorXd> &guess,
+                   Eigen::Ref<Eigen::VectorXd> solution) {
+
+    if (!_matrix and !_stencil)
+        throw std::runtime_error("Solver: solve called before compute");
+
+    _backend->setControls(_tolerance, _iterationsMax);
+    _isConverged = _backend->solve(freeVector, guess, solution);
+
+    // a stale preconditioner gets one more chance after a refresh
+    if (!_isConverged and _iterationsRefresh >= 0) {
+        refresh();
+        _isConverged = _backend->solve(freeVector, guess, solution);
+    }
+
+    _iterations = _backend->iterations();
+    _error = _backend->error();
+
+    if (_iterationsRefresh < 0)
+        _iterationsRefresh = _iterations;
+    else if (_iterations > _refreshGrowth * std::max(_iterationsRefresh, 1))
+        _isRefreshNeeded = true;
+}
@@ -0,0 +1,114 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef SOLVER_H
+#define SOLVER_H
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include "Stencil.h"
+
+typedef Eigen::SparseMatrix<double, Eigen::RowMajor> Matrix;
+
+class SolverBackend;
+
+// Linear solver living for the whole Equation lifetime. Works on the
+// RowMajor matrix in place, so no conversion happens before a solve.
+// Iterative methods refresh the preconditioner every _refreshPeriod
+// updates or as soon as the iterations number grows by _refreshGrowth
+// since the last refresh; direct methods (ldlt, llt) analyse the pattern
+// on compute and refactorize numerically on every update. A matrix-free
+// Stencil operator is solved by the iterative methods with the jacobi,
+// multigrid (Gauss-Seidel smoothed) or multigrid_jacobi preconditioners.
+class Solver {
+
+public:
+
+    explicit Solver(const std::string &method = "bicgstab",
+                    const std::string &preconditioner = "jacobi");
+
+    virtual ~Solver();
+
+    void compute(const Matrix &matrix);
+
+    void compute(const Stencil &stencil);
+
+    void update(const Matrix &matrix);
+
+    void update(const Stencil &stencil);
+
+    // operator values changed within a nonlinear iteration: iterative
+    // methods keep the preconditioner unless convergence degraded,
+    // direct methods refactorize
+    void updateValues(const Matrix &matrix);
+
+    void updateValues(const Stencil &stencil);
+
+    bool isComputed(const Matrix &matrix);
+
+    bool isComputed(const Stencil &stencil);
+
+    // forces compute on the next update, for a matrix rebuilt with a new
+    // pattern in place
+    void invalidate();
+
+    void solve(const Eigen::Ref<const Eigen::VectorXd> &freeVector,
+               const Eigen::Ref<const Eigen::VectorXd> &guess,
+               Eigen::Ref<Eigen::VectorXd> solution);
+
+    std::string _method;
+    std::string _preconditioner;
+
+    double _tolerance;
+    int _iterationsMax;
+    int _refreshPeriod;
+    double _refreshGrowth;
+
+    int _iterations;
+    double _error;
+    bool _isConverged;
+    int _refreshesN;
+
+private:
+
+    void update();
+
+    void refresh();
+
+    std::unique_ptr<SolverBackend> _backend;
+    const Matrix *_matrix;
+    const Stencil *_stencil;
+    const double *_values;
+    int _updatesN;
+    int _iterationsRefresh;
+    bool _isRefreshNeeded;
+
+};
+
+#endif // SOLVER_H
@@ -0,0 +1,80 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Stats.h"
+
+const std::array<std::string, Stats::phasesN> Stats::phasesNames{
+        "calc_betas", "calc_alphas", "process_non_bound_faces",
+        "fill_matrix", "process_dirich_cells", "solve"};
+
+Stats::Stats() {
+    clear();
+}
+
+void Stats::clear() {
+
+    _stepsN = 0;
+    for (auto &seconds : _seconds)
+        seconds.clear();
+    _solvesN.clear();
+    _iterations.clear();
+    _errors.clear();
+    _isConverged.clear();
+
+    _secondsTotal.fill(0);
+    _iterationsTotal = 0;
+    _nonConvergedN = 0;
+}
+
+void Stats::startStep() {
+
+    _stepsN++;
+    for (auto &seconds : _seconds)
+        seconds.push_back(0);
+    _solvesN.push_back(0);
+    _iterations.push_back(0);
+    _errors.push_back(0);
+    _isConverged.push_back(true);
+}
+
+void Stats::addSeconds(const Phase &phase, const double &seconds) {
+
+    if (!_stepsN)
+        startStep();
+    _seconds[phase].back() += seconds;
+    _secondsTotal[phase] += seconds;
+}
+
+void Stats::addSolve(const int &iterations, const double &error,
+                     const bool &isConverged) {
+
+    if (!_stepsN)
+        startStep();
+    _solvesN.back()++;
+    _iterations.back() += iterations;
+    _errors.back() = error;
+    _iterationsTotal += iterations;
+    if (_isConverged.back() and !isConverged)
+        _nonConvergedN++;
+    _isConverged.back() = _isConverged.back() and isConverged;
+}
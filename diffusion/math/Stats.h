@@ -0,0 +1,110 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Statistics of every cfdProcedureOneStep call: seconds spent in each
+// phase (measured only if built with DFVM_TIMERS) and the linear solves
+// of the step (Picard ones included): their number, iterations in total,
+// the error of the last one and whether all of them converged.
+class Stats {
+
+public:
+
+    enum Phase {
+        calcBetas, calcAlphas, processNonBoundFaces, fillMatrix,
+        processDirichCells, solve, phasesN
+    };
+
+#ifdef DFVM_TIMERS
+    static constexpr bool isTimed = true;
+#else
+    static constexpr bool isTimed = false;
+#endif
+
+    static const std::array<std::string, phasesN> phasesNames;
+
+    explicit Stats();
+
+    virtual ~Stats() {}
+
+    void clear();
+
+    // a new row, the records below go to the last row
+    void startStep();
+
+    void addSeconds(const Phase &phase, const double &seconds);
+
+    void addSolve(const int &iterations, const double &error,
+                  const bool &isConverged);
+
+    uint64_t _stepsN;
+    std::array<std::vector<double>, phasesN> _seconds;
+    std::vector<int> _solvesN;
+    std::vector<int> _iterations;
+    std::vector<double> _errors;
+    std::vector<bool> _isConverged;
+
+    std::array<double, phasesN> _secondsTotal;
+    int64_t _iterationsTotal;
+    uint64_t _nonConvergedN;
+
+};
+
+// Adds the seconds from construction to destruction to phase of stats;
+// without DFVM_TIMERS it does nothing.
+class PhaseTimer {
+
+public:
+
+    typedef std::chrono::steady_clock Clock;
+
+    explicit PhaseTimer(Stats &stats, const Stats::Phase &phase) :
+            _stats(stats), _phase(phase) {
+        if constexpr (Stats::isTimed)
+            _start = Clock::now();
+    }
+
+    ~PhaseTimer() {
+        if constexpr (Stats::isTimed) {
+            std::chrono::duration<double> duration = Clock::now() - _start;
+            _stats.addSeconds(_phase, duration.count());
+        }
+    }
+
+private:
+
+    Stats &_stats;
+    Stats::Phase _phase;
+    Clock::time_point _start;
+
+};
+
+#endif // STATS_H
@@ -0,0 +1,115 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "Stencil.h"
+#include <stdexcept>
+
+Stencil::Stencil(std::shared_ptr<Sgrid> sgrid) :
+        _sgrid(sgrid),
+        _cellsDims{1, 1, 1},
+        _strides{0, 0, 0},
+        _diag(Eigen::VectorXd::Zero(_sgrid->_cellsN)) {
+
+    for (uint64_t face = 0; face < _sgrid->_facesN; face++) {
+        auto &cells = _sgrid->_neighborsCells.at(face);
+        if (cells.size() < 2)
+            continue;
+
+        auto &axis = _sgrid->_facesAxes[face];
+        uint64_t stride = cells[0] < cells[1] ? cells[1] - cells[0]
+                                              : cells[0] - cells[1];
+        if (_strides[axis] == 0)
+            _strides[axis] = stride;
+        else if (_strides[axis] != stride)
+            throw std::runtime_error(
+                    "Stencil: sgrid cells are not ordered as a structured grid");
+    }
+
+    // cells number along an axis is the ratio of the next larger stride
+    // (or of the cells number) to the stride of the axis
+    uint64_t cellsN = _sgrid->_cellsN;
+    uint64_t product = 1;
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        if (_strides[axis] == 0)
+            continue;
+        uint64_t next = cellsN;
+        for (auto &stride : _strides)
+            if (stride > _strides[axis] and stride < next)
+                next = stride;
+        _cellsDims[axis] = next / _strides[axis];
+        product *= _cellsDims[axis];
+    }
+    if (product != cellsN)
+        throw std::runtime_error(
+                "Stencil: sgrid cells are not ordered as a structured grid");
+
+    for (auto &couplings : _couplings)
+        couplings = Eigen::VectorXd::Zero(cellsN);
+}
+
+Stencil::Stencil(const std::array<uint64_t, 3> &cellsDims) :
+        _cellsDims(cellsDims),
+        _strides{1, cellsDims[0], cellsDims[0] * cellsDims[1]} {
+
+    auto cellsN = cellsDims[0] * cellsDims[1] * cellsDims[2];
+    for (uint8_t axis = 0; axis < 3; axis++)
+        if (_cellsDims[axis] == 1)
+            _strides[axis] = 0;
+
+    _diag = Eigen::VectorXd::Zero(cellsN);
+    for (auto &couplings : _couplings)
+        couplings = Eigen::VectorXd::Zero(cellsN);
+}
+
+void Stencil::setZero() {
+
+    _diag.setZero();
+    for (auto &couplings : _couplings)
+        couplings.setZero();
+}
+
+void Stencil::addCoupling(const uint64_t &cell0, const uint64_t &cell1,
+                          const uint8_t &axis, const double &coupling) {
+
+    auto &lower = std::min(cell0, cell1);
+    _couplings[axis][lower] += coupling;
+}
+
+// y += factor * A x. The axis loops are contiguous shifted products,
+// so every axis vectorizes the way the x axis does.
+void Stencil::applyAdd(const Eigen::Ref<const Eigen::VectorXd> &x,
+                       Eigen::Ref<Eigen::VectorXd> y,
+                       const double &factor) const {
+
+    y += factor * _diag.cwiseProduct(x);
+
+    for (uint8_t axis = 0; axis < 3; axis++) {
+        auto &stride = _strides[axis];
+        if (stride == 0)
+            continue;
+        auto n = _diag.size() - stride;
+        auto couplings = _couplings[axis].head(n);
+        y.head(n) -= factor * couplings.cwiseProduct(x.tail(n));
+        y.tail(n) -= factor * couplings.cwiseProduct(x.head(n));
+    }
+}
@@ -0,0 +1,150 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef STENCIL_H
+#define STENCIL_H
+
+#include <array>
+#include <iostream>
+#include <map>
+#include <vector>
+
+#include <Eigen/Dense>
+#include <Eigen/Sparse>
+
+#include <sgrid/Sgrid.h>
+
+class Stencil;
+
+namespace Eigen {
+    namespace internal {
+        template<>
+        struct traits<Stencil> :
+                public traits<SparseMatrix<double, RowMajor>> {
+        };
+    }
+}
+
+// Matrix-free symmetric 7-point operator of a structured sgrid:
+// (A x)_i = diag_i x_i - sum_axis (c_axis(i) x_(i + s) + c_axis(i - s) x_(i - s)),
+// where s is the cells stride of the axis and c_axis(i) couples cell i to
+// cell i + s. Only the diagonal and three coupling arrays are stored.
+class Stencil : public Eigen::EigenBase<Stencil> {
+
+public:
+
+    typedef double Scalar;
+    typedef double RealScalar;
+    typedef int StorageIndex;
+    enum {
+        ColsAtCompileTime = Eigen::Dynamic,
+        MaxColsAtCompileTime = Eigen::Dynamic,
+        IsRowMajor = true
+    };
+
+    explicit Stencil(std::shared_ptr<Sgrid> sgrid);
+
+    explicit Stencil(const std::array<uint64_t, 3> &cellsDims);
+
+    virtual ~Stencil() {}
+
+    Eigen::Index rows() const { return _diag.size(); }
+
+    Eigen::Index cols() const { return _diag.size(); }
+
+    template<typename Rhs>
+    Eigen::Product<Stencil, Rhs, Eigen::AliasFreeProduct>
+    operator*(const Eigen::MatrixBase<Rhs> &x) const {
+        return Eigen::Product<Stencil, Rhs, Eigen::AliasFreeProduct>
+                (*this, x.derived());
+    }
+
+    void setZero();
+
+    void addCoupling(const uint64_t &cell0, const uint64_t &cell1,
+                     const uint8_t &axis, const double &coupling);
+
+    void applyAdd(const Eigen::Ref<const Eigen::VectorXd> &x,
+                  Eigen::Ref<Eigen::VectorXd> y, const double &factor) const;
+
+    std::shared_ptr<Sgrid> _sgrid;
+
+    std::array<uint64_t, 3> _cellsDims;
+    std::array<uint64_t, 3> _strides;
+    Eigen::VectorXd _diag;
+    std::array<Eigen::VectorXd, 3> _couplings;
+
+};
+
+// Jacobi preconditioner of a Stencil for Eigen iterative solvers.
+class StencilJacobi {
+
+public:
+
+    StencilJacobi() {}
+
+    Eigen::Index rows() const { return _inverseDiag.size(); }
+
+    Eigen::Index cols() const { return _inverseDiag.size(); }
+
+    StencilJacobi &analyzePattern(const Stencil &) { return *this; }
+
+    StencilJacobi &factorize(const Stencil &stencil) {
+        _inverseDiag = (stencil._diag.array() != 0).select(
+                stencil._diag.cwiseInverse(), 1);
+        return *this;
+    }
+
+    StencilJacobi &compute(const Stencil &stencil) {
+        return factorize(stencil);
+    }
+
+    template<typename Rhs>
+    auto solve(const Eigen::MatrixBase<Rhs> &b) const {
+        return _inverseDiag.cwiseProduct(b.derived());
+    }
+
+    Eigen::ComputationInfo info() { return Eigen::Success; }
+
+    Eigen::VectorXd _inverseDiag;
+
+};
+
+namespace Eigen {
+    namespace internal {
+        template<typename Rhs>
+        struct generic_product_impl<Stencil, Rhs, SparseShape, DenseShape,
+                GemvProduct>
+                : generic_product_impl_base<Stencil, Rhs,
+                        generic_product_impl<Stencil, Rhs>> {
+
+            template<typename Dest>
+            static void scaleAndAddTo(Dest &dst, const Stencil &lhs,
+                                      const Rhs &rhs, const double &alpha) {
+                lhs.applyAdd(rhs, dst, alpha);
+            }
+        };
+    }
+}
+
+#endif // STENCIL_H
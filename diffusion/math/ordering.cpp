@@ -0,0 +1,153 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ordering.h"
+#include <algorithm>
+#include <numeric>
+
+// breadth first levels from root: the rows of the last level, the levels
+// number and the rows reached, marked in levels
+static uint64_t traverseLevels(const Matrix &pattern, const uint64_t &root,
+                               std::vector<int64_t> &levels,
+                               std::vector<uint64_t> &rows,
+                               std::vector<uint64_t> &lastLevel) {
+
+    auto outerIndices = pattern.outerIndexPtr();
+    auto innerIndices = pattern.innerIndexPtr();
+
+    for (auto &row : rows)
+        levels[row] = -1;
+    rows.assign(1, root);
+    levels[root] = 0;
+
+    for (uint64_t i = 0; i < rows.size(); i++)
+        for (auto k = outerIndices[rows[i]]; k < outerIndices[rows[i] + 1];
+             k++) {
+            auto &col = innerIndices[k];
+            if (levels[col] < 0) {
+                levels[col] = levels[rows[i]] + 1;
+                rows.push_back(col);
+            }
+        }
+
+    auto levelsN = levels[rows.back()] + 1;
+    lastLevel.clear();
+    for (auto &row : rows)
+        if (levels[row] == levelsN - 1)
+            lastLevel.push_back(row);
+    return levelsN;
+}
+
+std::vector<uint64_t> calcOrderingRCM(const Matrix &pattern) {
+
+    uint64_t rowsN = pattern.rows();
+    auto outerIndices = pattern.outerIndexPtr();
+    auto innerIndices = pattern.innerIndexPtr();
+
+    std::vector<uint64_t> degrees(rowsN);
+    for (uint64_t row = 0; row < rowsN; row++)
+        degrees[row] = outerIndices[row + 1] - outerIndices[row];
+    auto isLess = [&](const uint64_t &row0, const uint64_t &row1) {
+        return degrees[row0] < degrees[row1];
+    };
+
+    std::vector<uint64_t> roots(rowsN);
+    std::iota(roots.begin(), roots.end(), 0);
+    std::stable_sort(roots.begin(), roots.end(), isLess);
+
+    std::vector<uint64_t> order;
+    order.reserve(rowsN);
+    std::vector<bool> isOrdered(rowsN, false);
+    std::vector<int64_t> levels(rowsN, -1);
+    std::vector<uint64_t> rows, lastLevel, neighbours;
+
+    for (auto root : roots) {
+        if (isOrdered[root])
+            continue;
+
+        // pseudo-peripheral root: the least degree row of the last level
+        // while the levels number grows
+        auto levelsN = traverseLevels(pattern, root, levels, rows, lastLevel);
+        while (true) {
+            auto candidate = *std::min_element(lastLevel.begin(),
+                                               lastLevel.end(), isLess);
+            auto candidateLevelsN = traverseLevels(pattern, candidate, levels,
+                                                   rows, lastLevel);
+            if (candidateLevelsN <= levelsN)
+                break;
+            root = candidate;
+            levelsN = candidateLevelsN;
+        }
+
+        auto begin = order.size();
+        order.push_back(root);
+        isOrdered[root] = true;
+        for (auto i = begin; i < order.size(); i++) {
+            neighbours.clear();
+            for (auto k = outerIndices[order[i]];
+                 k < outerIndices[order[i] + 1]; k++)
+                if (!isOrdered[innerIndices[k]]) {
+                    neighbours.push_back(innerIndices[k]);
+                    isOrdered[innerIndices[k]] = true;
+                }
+            std::stable_sort(neighbours.begin(), neighbours.end(), isLess);
+            order.insert(order.end(), neighbours.begin(), neighbours.end());
+        }
+    }
+
+    std::reverse(order.begin(), order.end());
+    return order;
+}
+
+// bits of value spread to every third bit
+static uint64_t spreadBits(uint64_t value) {
+
+    value &= 0x1fffff;
+    value = (value | value << 32) & 0x1f00000000ffff;
+    value = (value | value << 16) & 0x1f0000ff0000ff;
+    value = (value | value << 8) & 0x100f00f00f00f00f;
+    value = (value | value << 4) & 0x10c30c30c30c30c3;
+    value = (value | value << 2) & 0x1249249249249249;
+    return value;
+}
+
+std::vector<uint64_t> calcOrderingMorton(
+        const std::vector<uint64_t> &cells,
+        const std::array<uint64_t, 3> &cellsDims,
+        const std::array<uint64_t, 3> &strides) {
+
+    std::vector<uint64_t> keys(cells.size(), 0);
+    for (uint64_t i = 0; i < cells.size(); i++)
+        for (uint8_t axis = 0; axis < 3; axis++)
+            if (strides[axis])
+                keys[i] |= spreadBits(cells[i] / strides[axis] %
+                                      cellsDims[axis]) << axis;
+
+    std::vector<uint64_t> order(cells.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [&](const uint64_t &i, const uint64_t &j) {
+                         return keys[i] < keys[j];
+                     });
+    return order;
+}
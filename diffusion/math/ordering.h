@@ -0,0 +1,44 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DFVM_ORDERING_H
+#define DFVM_ORDERING_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "Solver.h"
+
+// Orderings keeping coupled cells close in memory, as new to old index:
+// reverse Cuthill-McKee over the graph of a symmetric pattern (every
+// connected component from a pseudo-peripheral row) and the Morton
+// (Z curve) order of cells of a structured grid given its dims and strides.
+std::vector<uint64_t> calcOrderingRCM(const Matrix &pattern);
+
+std::vector<uint64_t> calcOrderingMorton(
+        const std::vector<uint64_t> &cells,
+        const std::array<uint64_t, 3> &cellsDims,
+        const std::array<uint64_t, 3> &strides);
+
+#endif // DFVM_ORDERING_H
@@ -0,0 +1,69 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "threads.h"
+#include <atomic>
+#include <stdexcept>
+#include <Eigen/Core>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+static const uint64_t itemsNPerThread = 4096;
+
+#ifdef _OPENMP
+static std::atomic<int> threadsNGlobal(omp_get_max_threads());
+#else
+static std::atomic<int> threadsNGlobal(1);
+#endif
+
+static thread_local int threadsNLocal = 0;
+
+void setThreadsN(const int &threadsN) {
+
+    if (threadsN < 1)
+        throw std::invalid_argument("threads_n must be positive");
+
+    threadsNGlobal = threadsN;
+    Eigen::setNbThreads(threadsN);
+}
+
+void setThreadsNLocal(const int &threadsN) {
+
+    if (threadsN < 0)
+        throw std::invalid_argument("threads_n must not be negative");
+
+    threadsNLocal = threadsN;
+}
+
+int getThreadsN() {
+    return threadsNLocal > 0 ? threadsNLocal : int(threadsNGlobal);
+}
+
+int getThreadsN(const uint64_t &itemsN) {
+
+    int threadsN = getThreadsN();
+    auto threadsNMax = itemsN / itemsNPerThread + 1;
+    return uint64_t(threadsN) < threadsNMax ? threadsN : int(threadsNMax);
+}
@@ -0,0 +1,43 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef DFVM_THREADS_H
+#define DFVM_THREADS_H
+
+#include <cstdint>
+
+// threads number of the parallel assembly loops (and, process wide, of
+// Eigen products); every loop writes distinct elements only, so results do
+// not depend on it
+void setThreadsN(const int &threadsN);
+
+int getThreadsN();
+
+// threads number for a loop over itemsN elements: small loops stay serial
+int getThreadsN(const uint64_t &itemsN);
+
+// overrides the threads number for the calling thread only (zero resets),
+// e.g. 1 in the workers of an ensemble
+void setThreadsNLocal(const int &threadsN);
+
+#endif //DFVM_THREADS_H
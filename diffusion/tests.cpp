@@ -0,0 +1,182 @@
+/* MIT License
+ *
+ * Copyright (c) 2020 Aleksandr Zhuravlyov and Zakhar Lanets
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+// Regression tests of the library on small synthetic sgrids, one function
+// per test, run by ctest through diffusion_tests; the exit code is the
+// number of failed tests.
+
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "Equation.h"
+#include "Ensemble.h"
+
+// a box sgrid, the arrays it maps and an Equation on it
+struct Case {
+    std::shared_ptr<Sgrid> sgrid;
+    Eigen::VectorXd concsArray1;
+    Eigen::VectorXd concsArray2;
+    std::shared_ptr<Props> props;
+    std::shared_ptr<Equation> equation;
+};
+
+static void check(const bool &isPassed, const std::string &message) {
+    if (!isPassed)
+        throw std::runtime_error(message);
+}
+
+static std::map<std::string, std::variant<double, int>> createParams() {
+    return {{"time_period", 10.}, {"time_step", 1.}, {"d_coeff_a", 0.01},
+            {"d_coeff_b", 0.15}, {"poro", 0.5}};
+}
+
+// initial concentrations concIni, Dirichlet 20 on left and 1 on right
+static std::unique_ptr<Case> createCase(const double &concIni) {
+
+    auto testCase = std::make_unique<Case>();
+    auto &sgrid = testCase->sgrid;
+    Eigen::Vector3ui16 pointsDims(9, 6, 3);
+    Eigen::Vector3d pointsOrigin(0, 0, 0);
+    Eigen::Vector3d spacing(1, 1, 1);
+    sgrid = std::make_shared<Sgrid>(pointsDims, pointsOrigin, spacing);
+
+    Eigen::VectorXui64 cells(sgrid->_cellsN);
+    for (uint64_t cell = 0; cell < sgrid->_cellsN; cell++)
+        cells[cell] = cell;
+    sgrid->setCellsType("active", cells);
+    sgrid->processTypesByCellsType("active");
+
+    testCase->concsArray1 = Eigen::VectorXd::Constant(sgrid->_cellsN,
+                                                           concIni);
+    testCase->concsArray2 = testCase->concsArray1;
+    for (auto &name : {"concs_array1", "concs_array2"})
+        sgrid->_cellsArrays.erase(name);
+    sgrid->_cellsArrays.emplace("concs_array1", Eigen::Map<Eigen::VectorXd>(
+            testCase->concsArray1.data(), sgrid->_cellsN));
+    sgrid->_cellsArrays.emplace("concs_array2", Eigen::Map<Eigen::VectorXd>(
+            testCase->concsArray2.data(), sgrid->_cellsN));
+
+    auto &props = testCase->props;
+    props = std::make_shared<Props>(createParams());
+    auto &equation = testCase->equation;
+    equation = std::make_shared<Equation>(
+            props, sgrid, std::make_shared<Local>(props, sgrid),
+            std::make_shared<Convective>(props, sgrid));
+    equation->_boundGroupsDirich = {"left", "right"};
+    equation->_concsBoundDirich = {{"left", 20.}, {"right", 1.}};
+
+    return testCase;
+}
+
+// concs_time views keep the Snapshots of their run, whose rows a later
+// run must not overwrite, in memory or in a mapped file
+static void testSnapshotsKept(const std::string &path) {
+
+    auto testCase = createCase(2);
+    auto &equation = *testCase->equation;
+    equation._snapshotsPath = path;
+    equation.cfdProcedure();
+
+    auto snapshots = equation._snapshots;
+    RowMatrix concsTime = snapshots->getConcs();
+
+    auto params = createParams();
+    params["d_coeff_b"] = 0.6;
+    testCase->props->setParams(params);
+    testCase->concsArray1.setConstant(5);
+    testCase->concsArray2.setConstant(5);
+    equation.cfdProcedure();
+
+    check(equation._snapshots != snapshots and
+          (equation._snapshots->getConcs() - concsTime).norm() > 0,
+          "the second run repeats the first one");
+    check(snapshots->getConcs() == concsTime,
+          "snapshots of the first run changed");
+}
+
+// an ensemble member with the params and Dirichlet values of the
+// prototype reproduces its cfdProcedure, concentrations and flow rates
+static void testEnsembleMember(const bool &isAdaptive) {
+
+    auto testCase = createCase(2);
+    auto &equation = testCase->equation;
+    auto params = createParams();
+    if (isAdaptive) {
+        params["time_tolerance"] = 1e-3;
+        params["time_step_min"] = 1e-3;
+        testCase->props->setParams(params);
+    }
+
+    std::map<std::string, Eigen::VectorXui64> facesGroups{
+            {"nonbound", testCase->sgrid->_typesFaces.at("active_nonbound")}};
+    Ensemble ensemble(equation);
+    ensemble.run({params}, {equation->_concsBoundDirich}, facesGroups, 1);
+
+    equation->_monitors->addFaces("nonbound", facesGroups["nonbound"]);
+    equation->cfdProcedure();
+    auto &concs = equation->_concs[equation->iCurr];
+    auto flowRates = equation->_monitors->getFlowRates("nonbound");
+    auto &memberFlowRates = ensemble._flowRates[0]["nonbound"];
+
+    check((ensemble._concs[0] - concs).cwiseAbs().maxCoeff() <=
+          1e-10 * concs.cwiseAbs().maxCoeff(),
+          "member concentrations differ from cfd_procedure");
+    check(ensemble._timeSteps[0] == equation->_local->_timeSteps and
+          memberFlowRates.size() == uint64_t(flowRates.size()),
+          "member steps differ from cfd_procedure");
+    for (Eigen::Index i = 0; i < flowRates.size(); i++)
+        check(std::abs(memberFlowRates[i] - flowRates[i]) <=
+              1e-10 * std::abs(flowRates[i]),
+              "member flow rates differ from cfd_procedure");
+}
+
+int main() {
+
+    std::vector<std::pair<std::string, std::function<void()>>> tests{
+            {"snapshots_kept", [] { testSnapshotsKept(""); }},
+            {"snapshots_kept_mapped", [] {
+                testSnapshotsKept("diffusion_tests_snapshots.bin");
+            }},
+            {"ensemble_member", [] { testEnsembleMember(false); }},
+            {"ensemble_member_adaptive", [] { testEnsembleMember(true); }}};
+
+    int failedN = 0;
+    for (auto &[name, test] : tests) {
+        try {
+            test();
+            std::cerr << name << " passed" << std::endl;
+        } catch (const std::exception &exception) {
+            std::cerr << name << " FAILED: " << exception.what() << std::endl;
+            failedN++;
+        }
+    }
+    std::remove("diffusion_tests_snapshots.bin");
+    return failedN;
+}
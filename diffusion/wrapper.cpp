@@ -24,6 +24,7 @@
 
 #include <pybind11/pybind11.h>
 #include <pybind11/eigen.h>
+#include <pybind11/numpy.h>
 #include <pybind11/stl.h>
 
 #include "math/Props.h"
@@ -31,24 +32,87 @@
 #include "math/Local.h"
 #include "math/Convective.h"
 #include "math/funcs.h"
+#include "math/Solver.h"
+#include "math/Snapshots.h"
+#include "math/Monitors.h"
+#include "math/FluxOperator.h"
+#include "math/Stats.h"
+#include "math/threads.h"
 #include "Equation.h"
+#include "Ensemble.h"
 
 namespace py = pybind11;
 using namespace pybind11::literals;
 
+// NumPy view of size doubles at data, base keeps the memory alive
+static py::array_t<double> makeView(double *data, const uint64_t &size,
+                                    py::handle base) {
+    return py::array_t<double>({py::ssize_t(size)},
+                               {py::ssize_t(sizeof(double))}, data, base);
+}
+
+// row major rows x cols view
+static py::array_t<double> makeView(double *data, const uint64_t &rows,
+                                    const uint64_t &cols, py::handle base) {
+    return py::array_t<double>({py::ssize_t(rows), py::ssize_t(cols)},
+                               {py::ssize_t(cols * sizeof(double)),
+                                py::ssize_t(sizeof(double))}, data, base);
+}
+
+// NumPy copies, for buffers that are reallocated or freed later
+static py::array_t<double> makeCopy(const double *data,
+                                    const uint64_t &size) {
+    return py::array_t<double>({py::ssize_t(size)}, data);
+}
+
+static py::array_t<double> makeCopy(const double *data, const uint64_t &rows,
+                                    const uint64_t &cols) {
+    return py::array_t<double>({py::ssize_t(rows), py::ssize_t(cols)}, data);
+}
+
+// base of views into memory owned by a shared object
+template<class T>
+static py::capsule makeCapsule(const std::shared_ptr<T> &owner) {
+    return py::capsule(new std::shared_ptr<T>(owner), [](void *ptr) {
+        delete static_cast<std::shared_ptr<T> *>(ptr);
+    });
+}
+
+// copies values in place, so views of sink stay valid
+static void assignValues(const std::vector<double> &source,
+                         std::vector<double> &sink) {
+    if (source.size() != sink.size())
+        throw std::invalid_argument("values size " +
+                                    std::to_string(source.size()) +
+                                    " differs from " +
+                                    std::to_string(sink.size()));
+    std::copy(source.begin(), source.end(), sink.begin());
+}
+
 PYBIND11_MODULE(diffusion_bind, m) {
 
     m.def("calc_poro", calcPoro, "conc"_a, "poro"_a);
     m.def("calc_a_func", calcAFunc, "conc"_a, "poro"_a);
     m.def("calc_b_func", calcBFunc, "conc"_a, "diffusivity"_a,
           "poro"_a);
+    m.def("set_threads_n", setThreadsN, "threads_n"_a);
+    m.def("get_threads_n", py::overload_cast<>(getThreadsN));
 
     py::class_<Props, std::shared_ptr<Props>>(m, "Props")
-            .def(py::init<const std::map<std::string, std::variant<double, int>> &>(),
-                 "params"_a)
+            .def(py::init<const std::map<std::string, std::variant<double, int>> &,
+                         const std::string &>(),
+                 "params"_a, "model"_a = "linear")
 
-            .def_readwrite("params", &Props::_params)
-            .def("calc_D", &Props::calcD, "conc"_a)
+            .def_property("model", &Props::getModel, &Props::setModel)
+            .def_property("params",
+                          [](Props &self) { return self._params; },
+                          &Props::setParams)
+            .def("calc_D", py::overload_cast<const double &>(&Props::calcD),
+                 "conc"_a)
+            .def("calc_D", py::overload_cast<
+                         const Eigen::Ref<const Eigen::VectorXd> &,
+                         Eigen::Ref<Eigen::VectorXd>>(&Props::calcD),
+                 "concs"_a, "diffusivities"_a.noconvert())
             .def("print_params", &Props::printParams);
 
     py::class_<Boundary, std::shared_ptr<Boundary>>(m, "Boundary")
@@ -64,20 +128,133 @@ PYBIND11_MODULE(diffusion_bind, m) {
 
             .def("calc_time_steps", &Local::calcTimeSteps)
             .def("calc_alphas", &Local::calcAlphas,
-                 "concs"_a, "time_step"_a)
+                 "concs"_a, "time_step"_a,
+                 py::call_guard<py::gil_scoped_release>())
             .def_readwrite("time_steps", &Local::_timeSteps)
-            .def_readwrite("alphas", &Local::_alphas);
+            .def_property("alphas",
+                          [](py::object self) {
+                              auto &alphas = self.cast<Local &>()._alphas;
+                              return makeView(alphas.data(), alphas.size(),
+                                              self);
+                          },
+                          [](Local &self, const std::vector<double> &alphas) {
+                              assignValues(alphas, self._alphas);
+                          });
 
 
     py::class_<Convective, std::shared_ptr<Convective>>(m, "Convective")
-            .def(py::init<std::shared_ptr<Props>, std::shared_ptr<Sgrid>>(),
-                 "props"_a, "sgrid"_a)
+            .def(py::init<std::shared_ptr<Props>, std::shared_ptr<Sgrid>,
+                         const std::string &>(),
+                 "props"_a, "sgrid"_a, "weighing"_a = "meanAverage")
 
+            .def_property("weighing", &Convective::getWeighing,
+                          &Convective::setWeighing)
             .def("weigh_conc", &Convective::weighing, "method"_a,
                  "conc_first"_a, "conc_second"_a)
             .def("calc_betas", &Convective::calcBetas,
-                 "concs"_a)
-            .def_readwrite("betas", &Convective::_betas);
+                 "concs"_a,
+                 py::call_guard<py::gil_scoped_release>())
+            .def_property("betas",
+                          [](py::object self) {
+                              auto &betas = self.cast<Convective &>()._betas;
+                              return makeView(betas.data(), betas.size(),
+                                              self);
+                          },
+                          [](Convective &self, const std::vector<double> &betas) {
+                              assignValues(betas, self._betas);
+                          });
+
+    py::class_<Snapshots, std::shared_ptr<Snapshots>>(m, "Snapshots")
+            .def_property_readonly(
+                    "concs", py::overload_cast<>(&Snapshots::getConcs),
+                    py::return_value_policy::reference_internal)
+            .def_readonly("times", &Snapshots::_times)
+            .def_readonly("path", &Snapshots::_path);
+
+    py::class_<Monitors, std::shared_ptr<Monitors>>(m, "Monitors")
+            .def("add_faces", &Monitors::addFaces, "name"_a, "faces"_a)
+            .def("add_cells", &Monitors::addCells, "name"_a, "cells"_a)
+            .def("clear", &Monitors::clear)
+            .def_readonly("faces", &Monitors::_faces)
+            .def_readonly("cells", &Monitors::_cells)
+            // copies: every run reallocates the records
+            .def_property_readonly(
+                    "times",
+                    [](Monitors &self) {
+                        return makeCopy(self._times.data(), self._recordedN);
+                    })
+            .def_property_readonly(
+                    "flow_rates",
+                    [](Monitors &self) {
+                        py::dict flowRates;
+                        for (auto &[name, values] : self._flowRates)
+                            flowRates[py::str(name)] = makeCopy(
+                                    values.data(), self._recordedN);
+                        return flowRates;
+                    })
+            .def_property_readonly(
+                    "concs",
+                    [](Monitors &self) {
+                        py::dict concs;
+                        for (auto &[name, values] : self._concs)
+                            concs[py::str(name)] = makeCopy(
+                                    values.data(), self._recordedN,
+                                    values.cols());
+                        return concs;
+                    });
+
+    py::class_<FluxOperator, std::shared_ptr<FluxOperator>>(m, "FluxOperator")
+            .def(py::init<std::shared_ptr<Sgrid>,
+                         const std::map<std::string, Eigen::VectorXui64> &>(),
+                 "sgrid"_a, "groups"_a)
+            .def_readonly("names", &FluxOperator::_names)
+            .def_readonly("indices", &FluxOperator::_indices);
+
+    py::class_<Stats, std::shared_ptr<Stats>>(m, "Stats")
+            .def("clear", &Stats::clear)
+            .def_readonly_static("is_timed", &Stats::isTimed)
+            .def_readonly("steps_n", &Stats::_stepsN)
+            // copies: the per step records grow and are cleared by runs
+            .def_property_readonly(
+                    "seconds",
+                    [](Stats &self) {
+                        py::dict seconds;
+                        for (int i = 0; i < Stats::phasesN; i++)
+                            seconds[py::str(Stats::phasesNames[i])] =
+                                    makeCopy(self._seconds[i].data(),
+                                             self._stepsN);
+                        return seconds;
+                    })
+            .def_property_readonly(
+                    "seconds_total",
+                    [](Stats &self) {
+                        std::map<std::string, double> seconds;
+                        for (int i = 0; i < Stats::phasesN; i++)
+                            seconds[Stats::phasesNames[i]] =
+                                    self._secondsTotal[i];
+                        return seconds;
+                    })
+            .def_readonly("solves_n", &Stats::_solvesN)
+            .def_readonly("iterations", &Stats::_iterations)
+            .def_readonly("errors", &Stats::_errors)
+            .def_readonly("is_converged", &Stats::_isConverged)
+            .def_readonly("iterations_total", &Stats::_iterationsTotal)
+            .def_readonly("non_converged_n", &Stats::_nonConvergedN);
+
+    py::class_<Solver, std::shared_ptr<Solver>>(m, "Solver")
+            .def(py::init<const std::string &, const std::string &>(),
+                 "method"_a = "bicgstab", "preconditioner"_a = "jacobi")
+
+            .def_readonly("method", &Solver::_method)
+            .def_readonly("preconditioner", &Solver::_preconditioner)
+            .def_readwrite("tolerance", &Solver::_tolerance)
+            .def_readwrite("iterations_max", &Solver::_iterationsMax)
+            .def_readwrite("refresh_period", &Solver::_refreshPeriod)
+            .def_readwrite("refresh_growth", &Solver::_refreshGrowth)
+            .def_readonly("iterations", &Solver::_iterations)
+            .def_readonly("error", &Solver::_error)
+            .def_readonly("is_converged", &Solver::_isConverged)
+            .def_readonly("refreshes_n", &Solver::_refreshesN);
 
     py::class_<Equation, std::shared_ptr<Equation>>(m, "Equation")
             .def(py::init<std::shared_ptr<Props>, std::shared_ptr<Sgrid>,
@@ -85,25 +262,106 @@ PYBIND11_MODULE(diffusion_bind, m) {
                  "props"_a, "sgrid"_a,
                  "local"_a, "convective"_a)
 
-            .def("fill_matrix", &Equation::fillMatrix)
-            .def("calc_concs_implicit", &Equation::calcConcsImplicit)
-            .def("calc_concs_explicit", &Equation::calcConcsExplicit)
+            .def("fill_matrix", &Equation::fillMatrix,
+                 py::call_guard<py::gil_scoped_release>())
+            .def("invalidate_topology", &Equation::invalidateTopology)
+            .def("calc_concs_implicit", &Equation::calcConcsImplicit,
+                 py::call_guard<py::gil_scoped_release>())
+            .def("calc_concs_explicit", &Equation::calcConcsExplicit,
+                 py::call_guard<py::gil_scoped_release>())
             .def("cfd_procedure_one_step", &Equation::cfdProcedureOneStep,
-                 "timeStep"_a)
-            .def("cfd_procedure", &Equation::cfdProcedure)
+                 "timeStep"_a,
+                 py::call_guard<py::gil_scoped_release>())
+            .def("cfd_procedure", &Equation::cfdProcedure,
+                 "scheme"_a = "implicit",
+                 py::call_guard<py::gil_scoped_release>())
             .def("calc_faces_flow_rate", &Equation::calcFacesFlowRate,
-                 "faces"_a)
+                 "faces"_a,
+                 py::call_guard<py::gil_scoped_release>())
+            .def("calc_flow_rates", &Equation::calcFlowRates,
+                 "flux_operator"_a,
+                 py::call_guard<py::gil_scoped_release>())
+            .def_readwrite("solver", &Equation::_solver)
+            .def_property("scheme",
+                          [](Equation &self) { return self._scheme; },
+                          &Equation::setScheme)
+            .def_readonly("stages_n", &Equation::_stagesN)
+            .def_readonly("picard_iterations", &Equation::_picardIterations)
+            .def_readonly("picard_iterations_total",
+                          &Equation::_picardIterationsTotal)
+            .def_readonly("is_picard_converged",
+                          &Equation::_isPicardConverged)
+            .def_readwrite("time_invariant", &Equation::_isTimeInvariant)
+            .def_property("matrix_free",
+                          &Equation::getMatrixFree, &Equation::setMatrixFree)
+            .def_property("compact",
+                          [](Equation &self) { return self._isCompact; },
+                          &Equation::setCompact)
+            .def_property("ordering",
+                          [](Equation &self) { return self._ordering; },
+                          &Equation::setOrdering)
             .def_readwrite("dim", &Equation::dim)
             .def_readwrite("i_curr", &Equation::iCurr)
             .def_readwrite("i_prev", &Equation::iPrev)
             .def_readwrite("bound_groups_dirich", &Equation::_boundGroupsDirich)
             .def_readwrite("concs_bound_dirich", &Equation::_concsBoundDirich)
             .def_property("concs_ini",
-                          &Equation::getConcsIni, &Equation::setConcsIni)
+                          [](py::object self) {
+                              auto &equation = self.cast<Equation &>();
+                              return makeView(equation._concsIni.data(),
+                                              equation.dim, self);
+                          },
+                          &Equation::setConcsIni)
             .def_property("concs",
-                          &Equation::getConcs, &Equation::setConcs)
+                          [](py::object self) {
+                              auto &equation = self.cast<Equation &>();
+                              py::list concs;
+                              for (auto &conc : equation._concs)
+                                  concs.append(makeView(conc.data(),
+                                                        equation.dim, self));
+                              return concs;
+                          },
+                          &Equation::setConcs)
             .def_property("concs_time",
-                          &Equation::getConcsTime, &Equation::setConcsTime);
+                          [](Equation &self) {
+                              py::list concsTime;
+                              if (!self._snapshots)
+                                  return concsTime;
+                              auto base = makeCapsule(self._snapshots);
+                              for (uint64_t i = 0;
+                                   i < self._snapshots->_savedN; i++)
+                                  concsTime.append(makeView(
+                                          self._snapshots->getConcs(i).data(),
+                                          self.dim, base));
+                              return concsTime;
+                          },
+                          &Equation::setConcsTime)
+            .def_property_readonly(
+                    "free_vector",
+                    [](py::object self) {
+                        auto &equation = self.cast<Equation &>();
+                        return makeView(equation.freeVector.data(),
+                                        equation.dim, self);
+                    })
+            .def_readwrite("output_period", &Equation::_outputPeriod)
+            .def_readwrite("output_times", &Equation::_outputTimes)
+            .def_readwrite("snapshots_path", &Equation::_snapshotsPath)
+            .def_readonly("snapshots", &Equation::_snapshots)
+            .def_readonly("monitors", &Equation::_monitors)
+            .def_readonly("stats", &Equation::_stats);
+
+    py::class_<Ensemble, std::shared_ptr<Ensemble>>(m, "Ensemble")
+            .def(py::init<std::shared_ptr<Equation>>(), "prototype"_a)
+
+            .def("run", &Ensemble::run, "params_sets"_a,
+                 "concs_bounds"_a = std::vector<std::map<std::string, double>>(),
+                 "faces_groups"_a = std::map<std::string, Eigen::VectorXui64>(),
+                 "threads_n"_a = 0,
+                 py::call_guard<py::gil_scoped_release>())
+            .def_readonly("prototype", &Ensemble::_prototype)
+            .def_readonly("concs", &Ensemble::_concs)
+            .def_readonly("flow_rates", &Ensemble::_flowRates)
+            .def_readonly("time_steps", &Ensemble::_timeSteps);
 
 
 }